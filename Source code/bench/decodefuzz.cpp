@@ -0,0 +1,23 @@
+// Драйвер дифференциального фаззинга decodeSource (decodefuzz.py): текст со
+// стандартного входа, на выходе "<SourceEncoding> " и перекодированный текст
+// или "U <смещение> <код>" для символа вне Windows-1251.
+// Каталог "cpp files" содержит пробел, пути передаются через -print0:
+//   find "../cpp files" -name '*.cpp' ! -name main.cpp -print0 |
+//       xargs -0 g++ -std=c++17 -O2 -I"../headers files" -pthread -o decodefuzz decodefuzz.cpp
+//   python3 decodefuzz.py ./decodefuzz
+#include <precomph.h>
+
+int main() {
+    std::string text((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+    std::string out;
+    size_t bad_pos;
+    unsigned bad_code;
+    SourceEncoding encoding = decodeSource(text, out, bad_pos, bad_code);
+    if (encoding == SOURCE_UNMAPPABLE) {
+        std::printf("U %zu %X", bad_pos, bad_code);
+        return 0;
+    }
+    std::printf("%d ", static_cast<int>(encoding));
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    return 0;
+}
@@ -0,0 +1,52 @@
+# Дифференциальный фаззинг decodeSource: случайные тексты из фрагментов
+# UTF-8 (в том числе неправильных) сравниваются с перекодировкой Python.
+# Запуск: python3 decodefuzz.py ./decodefuzz [число_тестов]
+import random
+import subprocess
+import sys
+
+
+def reference(data):
+    try:
+        text = data.decode("utf-8")
+    except UnicodeDecodeError:
+        return b"0 " + data
+    bom = text.startswith("\ufeff")
+    if not bom and all(ord(ch) < 128 for ch in text):
+        return b"0 " + data
+    if bom:
+        text = text[1:]
+    out = bytearray()
+    pos = 3 if bom else 0
+    for ch in text:
+        try:
+            out += ch.encode("cp1251")
+        except UnicodeEncodeError:
+            return ("U %d %X" % (pos, ord(ch))).encode()
+        pos += len(ch.encode("utf-8"))
+    return b"1 " + bytes(out)
+
+
+# Первые пять фрагментов - корректный текст, остальные - символы вне
+# Windows-1251, BOM, переизбыточные и суррогатные последовательности, обрывки
+fragments = [b"a", b"\n", b"x" * 20, "я".encode(), "Ё".encode(), "№".encode(), "€".encode(),
+             "☃".encode(), "\U0001F600".encode(), b"\xef\xbb\xbf", b"\xc0", b"\xe0\x80\x80",
+             b"\xed\xa0\x80", b"\xf4\x90\x80\x80", b"\xd0", b"\x80", "\u00a0".encode(), b"\xc2\x98"]
+
+driver = sys.argv[1] if len(sys.argv) > 1 else "./decodefuzz"
+tests = int(sys.argv[2]) if len(sys.argv) > 2 else 3000
+random.seed(1)
+mismatches = 0
+for _ in range(tests):
+    if random.random() < 0.3:
+        data = b"".join(random.choice(fragments[:5]) for _ in range(random.randint(0, 60)))
+    else:
+        data = b"".join(random.choice(fragments) for _ in range(random.randint(0, 40)))
+    got = subprocess.run([driver], input=data, capture_output=True).stdout
+    expected = reference(data)
+    if got != expected:
+        mismatches += 1
+        if mismatches <= 5:
+            print(data, got, expected)
+print("mismatches", mismatches)
+sys.exit(1 if mismatches else 0)
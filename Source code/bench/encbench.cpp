@@ -0,0 +1,121 @@
+// Замер и проверка поиска недопустимого байта Windows-1251: векторные
+// варианты (SSE2, AVX2) сверяются со скалярным на случайных строках, затем
+// меряется скорость на 1/16/64 МБ и decodeSource на файлах из аргументов.
+// Бенчмарк #include-ит encoding.cpp ради static-функций поиска, поэтому
+// encoding.cpp исключается из сборки, иначе его функции будут определены
+// дважды. Каталог "cpp files" содержит пробел, пути передаются через -print0:
+//   find "../cpp files" -name '*.cpp' ! -name main.cpp ! -name encoding.cpp -print0 |
+//       xargs -0 g++ -std=c++17 -O2 -I"../headers files" -pthread -o encbench encbench.cpp
+//   ./encbench [FILE...]
+#include "../cpp files/encoding.cpp"
+#include <chrono>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point from) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - from).count();
+}
+
+struct Finder {
+    const char* name;
+    InvalidByteFinder find;
+};
+
+static std::vector<Finder> finders() {
+    std::vector<Finder> result = {{"scalar", findInvalidPortable}};
+#ifdef NGS_SSE2
+    result.push_back({"sse2", findInvalidSSE2});
+#endif
+#ifdef NGS_X86
+    if (cpuHasAVX2()) {
+        result.push_back({"avx2", findInvalidAVX2});
+    }
+#endif
+    return result;
+}
+
+// Среднее время одного прохода по text, мс
+static double timeFinder(InvalidByteFinder find, const std::string& text, int repeats) {
+    size_t sink = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < repeats; i++) {
+        sink += find(text.data(), text.size());
+    }
+    double ms = elapsedMs(start) / repeats;
+    if (sink == 1) {
+        std::puts("");  // Не дает компилятору выбросить вызовы
+    }
+    return ms;
+}
+
+int main(int argc, char** argv) {
+    initWindows1251Table();
+    std::vector<Finder> variants = finders();
+    std::mt19937 rng(1);
+
+    // Короткие строки: хвосты и граница блока важнее длинных прогонов
+    for (int test = 0; test < 200000; test++) {
+        std::string text(rng() % 100, ' ');
+        for (auto& c : text) {
+            unsigned value = rng() % 4 ? 0x20 + rng() % 0x5E : rng() % 256;
+            c = static_cast<char>(value);
+        }
+        size_t expected = findInvalidScalar(text.data(), 0, text.size());
+        for (const auto& variant : variants) {
+            size_t found = variant.find(text.data(), text.size());
+            if (found != expected) {
+                std::printf("MISMATCH %s: %zu, expected %zu\n", variant.name, found, expected);
+                return 1;
+            }
+        }
+    }
+    std::puts("fuzz ok");
+
+    for (size_t mb : {1, 16, 64}) {
+        // Текст без недопустимых байтов: проход до конца буфера
+        std::string text(mb << 20, 'a');
+        for (auto& c : text) {
+            unsigned value = rng() % 100;
+            c = value < 70 ? static_cast<char>(0x20 + value % 0x5E)
+              : value < 85 ? static_cast<char>(0xC0 + value % 64)
+              : value < 95 ? ' ' : '\n';
+        }
+        int repeats = mb == 1 ? 200 : 20;
+        std::printf("%3zu MB:", mb);
+        for (const auto& variant : variants) {
+            double ms = timeFinder(variant.find, text, repeats);
+            std::printf("  %s %.3f ms (%.2f GB/s)", variant.name, ms, text.size() / ms / 1e6);
+        }
+        std::printf("\n");
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string text;
+        if (FileWork::ReadFile(argv[i], text) != 0) {
+            std::cerr << "cannot read " << argv[i] << "\n";
+            return 1;
+        }
+        std::string out;
+        size_t bad_pos;
+        unsigned bad_code;
+        SourceEncoding encoding = SOURCE_WINDOWS1251;
+        double decode_ms = 1e9, copy_ms = 1e9;
+        for (int run = 0; run < 10; run++) {
+            Clock::time_point start = Clock::now();
+            encoding = decodeSource(text, out, bad_pos, bad_code);
+            decode_ms = std::min(decode_ms, elapsedMs(start));
+
+            // Копия строки - нижняя граница для decodeSource
+            start = Clock::now();
+            std::string copy(text);
+            copy_ms = std::min(copy_ms, elapsedMs(start));
+            if (copy.size() != text.size()) {
+                return 1;
+            }
+        }
+        std::printf("%s: %zu bytes, encoding %d, decode %.2f ms, copy %.2f ms\n",
+                    argv[i], text.size(), static_cast<int>(encoding), decode_ms, copy_ms);
+    }
+    return 0;
+}
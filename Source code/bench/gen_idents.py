@@ -0,0 +1,17 @@
+# Входные данные для lexbench: строки из ключевых слов и похожих на них
+# идентификаторов (~8 МБ). Запуск: python3 gen_idents.py > idents.txt
+import random
+import sys
+
+random.seed(1)
+keywords = ("procedure algo bool unsigned int string time_t ces est do while return "
+            "symb if else true false proclaim to_str TimeFled ThisVeryMoment unite sum4").split()
+identifiers = ["value", "counter", "index", "total_sum", "resultString", "tmp1", "x", "y",
+               "alpha", "beta_gamma", "isReady", "procedures", "integer", "whiles", "str"]
+
+size = 0
+while size < 8_000_000:
+    words = [random.choice(keywords if random.random() < 0.35 else identifiers) for _ in range(12)]
+    line = " ".join(words) + ";\n"
+    sys.stdout.write(line)
+    size += len(line)
@@ -0,0 +1,46 @@
+# Входные данные для prepbench: программы размером 1, 10 и 100 МБ с
+# ##inaddition, ##perceive, маркерами секций, комментариями @...@,
+# табуляцией и пустыми строками. Запуск: python3 gen_prep.py [МБ...]
+import random
+import sys
+
+random.seed(1)
+sizes = [int(arg) for arg in sys.argv[1:]] or [1, 10, 100]
+
+with open("prep_lib.txt", "w") as lib:
+    lib.write("[preprocessor section begin]\n##perceive LIMIT 30\n[preprocessor section end]\n\n"
+              "[function section begin]\nprocedure algo sayHi ()\n{\n\tproclaim(\"Hi\");\n}\n"
+              "[function section end]\n\n[superior function begin]\nces\n{\n}\n"
+              "[superior function end]\n")
+
+header = ("[preprocessor section begin]\n##program \"prep\"\n##inaddition \"prep_lib.txt\"\n"
+          + "".join("##perceive NAME%d %d\n" % (i, i) for i in range(50))
+          + "##perceive GREETING \"Hello\"\n[preprocessor section end]\n\n")
+
+
+def function(index):
+    lines = ["int algo Func%d (int a, int b)" % index, "{"]
+    for k in range(random.randint(3, 12)):
+        choice = random.random()
+        if choice < 0.2:
+            lines.append("\t@ comment %d @" % k)
+        elif choice < 0.3:
+            lines.append("   ")
+        else:
+            lines.append("\test int v%d;    \n\tv%d = a + NAME%d * b;  " % (k, k, random.randrange(50)))
+    lines += ["\tproclaim(GREETING);", "\treturn a;", "}", ""]
+    return "\n".join(lines) + "\n"
+
+
+for mb in sizes:
+    target = mb << 20
+    with open("prep_%dmb.txt" % mb, "w") as out:
+        out.write(header + "[functions section begin]\n")
+        size, index = 0, 0
+        while size < target:
+            text = function(index)
+            out.write(text)
+            size += len(text)
+            index += 1
+        out.write("[functions section end]\n\n[superior function begin]\nces\n{\n"
+                  "\tproclaim(NAME1);\n}\n[superior function end]\n")
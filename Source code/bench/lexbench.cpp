@@ -0,0 +1,92 @@
+// Замер лексера: время tokenize() на файле и поиск ключевого слова
+// совершенным хешем (find_word) против прежнего std::map.
+// Бенчмарк #include-ит lexer.cpp ради static find_word, поэтому lexer.cpp
+// исключается из сборки, иначе его функции будут определены дважды.
+// Каталог "cpp files" содержит пробел, пути передаются через -print0:
+//   find "../cpp files" -name '*.cpp' ! -name main.cpp ! -name lexer.cpp -print0 |
+//       xargs -0 g++ -std=c++17 -O2 -I"../headers files" -pthread -o lexbench lexbench.cpp
+//   python3 gen_idents.py > idents.txt && ./lexbench idents.txt
+#include "../cpp files/lexer.cpp"
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point from) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - from).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: lexbench FILE\n";
+        return 1;
+    }
+    std::string source;
+    if (FileWork::ReadFile(argv[1], source) != 0) {
+        std::cerr << "cannot read " << argv[1] << "\n";
+        return 1;
+    }
+
+    // Лучшее из нескольких прогонов: первый прогревает кэши и аллокатор
+    double best = 1e9;
+    size_t tokens = 0, not_identifiers = 0;
+    for (int run = 0; run < 7; run++) {
+        Clock::time_point start = Clock::now();
+        lexan::Lexer lexer(source, argv[1]);
+        std::vector<lexan::Token> result = lexer.tokenize();
+        best = std::min(best, elapsedMs(start));
+        tokens = result.size();
+        not_identifiers = 0;
+        for (const auto& token : result) {
+            not_identifiers += token.type != lexan::TK_IDENTIFIER;
+        }
+    }
+    std::printf("tokenize: %zu tokens (%zu not identifiers), best %.1f ms\n",
+                tokens, not_identifiers, best);
+
+    // Слова файла без разделителей - вход для обоих вариантов поиска
+    std::map<std::string, lexan::TokenType> by_map;
+    for (const auto& word : lexan::words) {
+        by_map[std::string(word.text)] = word.type;
+    }
+    std::vector<std::string> input;
+    std::istringstream stream(source);
+    std::string word;
+    while (stream >> word) {
+        if (word.back() == ';') {
+            word.pop_back();
+        }
+        input.push_back(word);
+    }
+    if (input.empty()) {
+        return 0;
+    }
+
+    for (int run = 0; run < 3; run++) {
+        Clock::time_point start = Clock::now();
+        size_t map_sum = 0;
+        for (const auto& text : input) {
+            auto it = by_map.find(text);
+            if (it != by_map.end()) {
+                map_sum += it->second;
+            }
+        }
+        double map_ms = elapsedMs(start);
+
+        start = Clock::now();
+        size_t hash_sum = 0;
+        for (const auto& text : input) {
+            if (const lexan::Word* found = lexan::find_word(text)) {
+                hash_sum += found->type;
+            }
+        }
+        double hash_ms = elapsedMs(start);
+
+        std::printf("%zu lookups: map %.2f ns, hash %.2f ns (%s)\n", input.size(),
+                    map_ms * 1e6 / input.size(), hash_ms * 1e6 / input.size(),
+                    map_sum == hash_sum ? "agree" : "DISAGREE");
+        if (map_sum != hash_sum) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Замер препроцессора: время PreprocessSource на файлах разного размера
+// (gen_prep.py). Время на мегабайт не должно расти с размером входа.
+// Каталог "cpp files" содержит пробел, пути передаются через -print0:
+//   find "../cpp files" -name '*.cpp' ! -name main.cpp -print0 |
+//       xargs -0 g++ -std=c++17 -O2 -I"../headers files" -pthread -o prepbench prepbench.cpp
+//   python3 gen_prep.py && ./prepbench prep_1mb.txt prep_10mb.txt prep_100mb.txt
+#include <precomph.h>
+#include <chrono>
+
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: prepbench FILE...\n";
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string source;
+        if (FileWork::ReadFile(argv[i], source) != 0) {
+            std::cerr << "cannot read " << argv[i] << "\n";
+            return 1;
+        }
+
+        // Лучшее из трех прогонов; файлы ##inaddition читаются с диска
+        double best = 1e9;
+        size_t output_size = 0;
+        for (int run = 0; run < 3; run++) {
+            std::string output, preprocessed, log_content;
+            Clock::time_point start = Clock::now();
+            short result = PreprocessSource(argv[i], source, output, preprocessed, log_content);
+            double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (result != 0) {
+                std::cerr << argv[i] << ": preprocessor error " << result << "\n";
+                return 1;
+            }
+            best = std::min(best, ms);
+            output_size = preprocessed.size();
+        }
+        double mb = source.size() / double(1 << 20);
+        std::printf("%s: %.1f MB -> %.1f MB, best %.1f ms, %.1f ms/MB\n", argv[i], mb,
+                    output_size / double(1 << 20), best, best / mb);
+    }
+    return 0;
+}
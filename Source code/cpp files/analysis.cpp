@@ -5,57 +5,65 @@
 #include <iomanip>
 #include <sstream>
 #include "precomph.h"
+#include "artifacts.h"
 
 namespace fs = std::filesystem;
 
 bool performSemanticAnalysis(parser::ASTNode* ast, 
                             const std::string& filename,
-                            semantic::SemanticAnalyzer& analyzer) {
-    std::cout << "Semantic analysis...\n";
+                            semantic::SemanticAnalyzer& analyzer,
+                            bool write_report) {
+    Log::info() << "Semantic analysis...\n";
+    TRACE_SCOPE("performSemanticAnalysis");
     
     if (!analyzer.analyze(ast)) {
-        std::cout << "Semantic analysis failed!\n";
+        Error::out() << "Semantic analysis failed!\n";
         
         const auto& errors = analyzer.get_errors();
         for (const auto& error : errors) {
-            std::cout << "  " << error << "\n";
+            Error::out() << "  " << error << "\n";
+        }
+        
+        if (!write_report) {
+            return false;
         }
         
         // Сохраняем отчет об ошибках
         std::string error_filename = filename + ".semantic.errors.txt";
-        std::ofstream error_file(error_filename);
-        if (error_file.is_open()) {
-            error_file << analyzer.generate_report();
-            error_file.close();
-            std::cout << "Error report saved to: " << error_filename << "\n";
+        if (artifacts::write(error_filename, analyzer.generate_report())) {
+            Log::info() << "Error report saved to: " << error_filename << "\n";
         }
         
         return false;
     }
     
-    std::cout << "Semantic analysis successful!\n";
+    Log::info() << "Semantic analysis successful!\n";
     
     // Выводим предупреждения
     const auto& warnings = analyzer.get_warnings();
     if (!warnings.empty()) {
-        std::cout << "\nWarnings:\n";
+        Error::out() << "\nWarnings:\n";
         for (const auto& warning : warnings) {
-            std::cout << "  " << warning << "\n";
+            Error::out() << "  " << warning << "\n";
         }
     }
     
+    if (!write_report) {
+        return true;
+    }
+    
     // Выводим информацию о символах и функциях
-    analyzer.print_symbol_table();
-    analyzer.print_function_table();
-    analyzer.print_type_summary();
+    if (Log::level() >= Log::LEVEL_INFO) {
+        analyzer.print_symbol_table();
+        analyzer.print_function_table();
+        analyzer.print_type_summary();
+    }
     
     // Сохраняем полный отчет
+    TRACE_SCOPE("write semantic report");
     std::string report_filename = filename + ".semantic.report.txt";
-    std::ofstream report_file(report_filename);
-    if (report_file.is_open()) {
-        report_file << analyzer.generate_report();
-        report_file.close();
-        std::cout << "\nSemantic analysis report saved to: " << report_filename << "\n";
+    if (artifacts::write(report_filename, analyzer.generate_report())) {
+        Log::info() << "\nSemantic analysis report saved to: " << report_filename << "\n";
     }
     
     return true;
@@ -63,11 +71,13 @@ bool performSemanticAnalysis(parser::ASTNode* ast,
 
 bool performRPNConversion(parser::ASTNode* ast, 
                          const std::string& filename,
-                         rpn::RPNConverter& converter) {
-    std::cout << "Converting expressions to Reverse Polish Notation...\n";
+                         rpn::RPNConverter& converter,
+                         bool write_rpn) {
+    Log::info() << "Converting expressions to Reverse Polish Notation...\n";
+    TRACE_SCOPE("performRPNConversion");
     
     if (!ast) {
-        std::cout << "Error: AST is null\n";
+        Error::out() << "Error: AST is null\n";
         return false;
     }
     
@@ -76,26 +86,29 @@ bool performRPNConversion(parser::ASTNode* ast,
     
     // Сохраняем результат
     std::string rpn_filename = filename + ".rpn.txt";
-    std::ofstream rpn_file(rpn_filename);
-    if (!rpn_file.is_open()) {
-        std::cout << "Error: Could not create RPN output file\n";
-        return false;
+    if (write_rpn) {
+        TRACE_SCOPE("write rpn");
+        if (!artifacts::write(rpn_filename, rpn_result)) {
+            Error::out() << "Error: Could not create RPN output file\n";
+            return false;
+        }
     }
     
-    rpn_file << rpn_result;
-    rpn_file.close();
-    
-    std::cout << "RPN conversion successful!\n";
-    std::cout << "RPN output saved to: " << rpn_filename << "\n";
+    Log::info() << "RPN conversion successful!\n";
+    if (write_rpn) {
+        Log::info() << "RPN output saved to: " << rpn_filename << "\n";
+    }
     
     // Выводим часть результата в консоль
-    std::cout << "\n=== RPN Result (first 50 lines) ===\n";
-    std::istringstream iss(rpn_result);
-    std::string line;
-    int line_count = 0;
-    while (std::getline(iss, line) && line_count < 50) {
-        std::cout << line << "\n";
-        line_count++;
+    if (Log::level() >= Log::LEVEL_INFO) {
+        Log::info() << "\n=== RPN Result (first 50 lines) ===\n";
+        std::istringstream iss(rpn_result);
+        std::string line;
+        int line_count = 0;
+        while (std::getline(iss, line) && line_count < 50) {
+            Log::info() << line << "\n";
+            line_count++;
+        }
     }
     
     return true;
@@ -105,10 +118,11 @@ bool performCodeGeneration(parser::ASTNode* ast,
                           const std::string& filename,
                           codegen::CodeGenerator& generator,
                           semantic::SemanticAnalyzer* analyzer) {
-    std::cout << "Generating JavaScript code...\n";
+    Log::info() << "Generating JavaScript code...\n";
+    TRACE_SCOPE("performCodeGeneration");
     
     if (!ast) {
-        std::cout << "Error: AST is null\n";
+        Error::out() << "Error: AST is null\n";
         return false;
     }
     
@@ -119,17 +133,19 @@ bool performCodeGeneration(parser::ASTNode* ast,
     std::string js_filename = filename + ".js";
     generator.save_to_file(js_filename);
     
-    std::cout << "Code generation successful!\n";
-    std::cout << "JavaScript file saved to: " << js_filename << "\n";
+    Log::info() << "Code generation successful!\n";
+    Log::info() << "JavaScript file saved to: " << js_filename << "\n";
     
     // Show first 50 lines
-    std::cout << "\n=== Generated JavaScript (first 50 lines) ===\n";
-    std::istringstream iss(js_code);
-    std::string line;
-    int line_count = 0;
-    while (std::getline(iss, line) && line_count < 50) {
-        std::cout << line << "\n";
-        line_count++;
+    if (Log::level() >= Log::LEVEL_INFO) {
+        Log::info() << "\n=== Generated JavaScript (first 50 lines) ===\n";
+        std::istringstream iss(js_code);
+        std::string line;
+        int line_count = 0;
+        while (std::getline(iss, line) && line_count < 50) {
+            Log::info() << line << "\n";
+            line_count++;
+        }
     }
     
     return true;
@@ -142,17 +158,18 @@ bool executeGeneratedCode(const std::string& js_filename) {
         std::string command = "node \"" + js_filename + "\"";
     #endif
     
-    std::cout << "Executing: " << command << "\n";
-    std::cout << "========================================\n";
+    Log::info() << "Executing: " << command << "\n";
+    Log::info() << "========================================\n";
     
+    Log::flush();
     int result = system(command.c_str());
     
-    std::cout << "========================================\n";
+    Log::info() << "========================================\n";
     if (result == 0) {
-        std::cout << "Execution completed successfully!\n";
+        Log::info() << "Execution completed successfully!\n";
         return true;
     } else {
-        std::cout << "Execution failed with error code: " << result << "\n";
+        Error::out() << "Execution failed with error code: " << result << "\n";
         return false;
     }
 }
\ No newline at end of file
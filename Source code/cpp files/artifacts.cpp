@@ -0,0 +1,151 @@
+#include <precomph.h>
+#include "artifacts.h"
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <thread>
+
+namespace artifacts {
+
+static thread_local Group* current_group = nullptr;
+
+bool writeNow(const std::string& filename, const std::string& data) {
+    TRACE_SCOPE("write artifact");
+    // Устройства и каналы (-f /dev/stdout) не заменяются переименованием
+    std::error_code ec;
+    fs::file_status status = fs::status(filename, ec);
+    bool in_place = !ec && fs::exists(status) && !fs::is_regular_file(status);
+
+    static std::atomic<unsigned> temp_counter(0);
+    std::string target = in_place ? filename
+                                  : filename + ".tmp" + std::to_string(temp_counter++);
+    FILE* file = std::fopen(target.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    written = std::fclose(file) == 0 && written;
+    if (in_place) {
+        return written;
+    }
+
+    if (written) {
+        fs::rename(target, filename, ec);
+        written = !ec;
+    }
+    if (!written) {
+        fs::remove(target, ec);
+    }
+    return written;
+}
+
+// Фоновый поток записи, общий для всех компиляций процесса (-batch,
+// -serve). Запускается при первой отправке, останавливается при выходе
+class Writer {
+private:
+    struct Job {
+        std::string filename;
+        std::string data;
+        Group* group;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> jobs;
+    bool stopping;
+    std::thread worker;
+
+    void run() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            bool written = writeNow(job.filename, job.data);
+            job.group->finished(job.filename, written);
+        }
+    }
+
+public:
+    Writer() : stopping(false), worker(&Writer::run, this) {}
+
+    ~Writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        worker.join();
+    }
+
+    void submit(const std::string& filename, std::string data, Group* group) {
+        group->submitted();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(Job{filename, std::move(data), group});
+        }
+        ready.notify_one();
+    }
+
+    static Writer& instance() {
+        static Writer writer;
+        return writer;
+    }
+};
+
+void Group::submitted() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending++;
+}
+
+void Group::finished(const std::string& filename, bool written) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!written) {
+        failed.push_back(filename);
+    }
+    // Уведомление под блокировкой: после wait() группа может быть разрушена
+    if (--pending == 0) {
+        done.notify_all();
+    }
+}
+
+bool Group::wait() {
+    std::vector<std::string> not_written;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+        not_written.swap(failed);
+    }
+    for (const auto& filename : not_written) {
+        Error::out() << "Error: Could not write file: " << filename << "\n";
+    }
+    return not_written.empty();
+}
+
+Group* Group::current() {
+    return current_group;
+}
+
+Group::Scope::Scope(Group* group) : saved(current_group) {
+    current_group = group;
+}
+
+Group::Scope::~Scope() {
+    current_group = saved;
+}
+
+bool write(const std::string& filename, std::string data) {
+    if (Group* group = Group::current()) {
+        Writer::instance().submit(filename, std::move(data), group);
+        return true;
+    }
+    return writeNow(filename, data);
+}
+
+} // namespace artifacts
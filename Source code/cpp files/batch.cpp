@@ -0,0 +1,170 @@
+#include <precomph.h>
+#include "batch.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace batch {
+
+bool readResponseFile(const std::string& filename, std::vector<Job>& jobs) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        Error::ThrowConsole(5);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+
+        Job job;
+        std::istringstream iss(line);
+        std::string name;
+        while (iss >> name) {
+            job.input_files.push_back(name);
+        }
+        if (!job.input_files.empty()) {
+            jobs.push_back(job);
+        }
+    }
+    return true;
+}
+
+static JobResult compileJob(const Job& job, short call, const CallOptions& options) {
+    JobResult result;
+    auto start = std::chrono::steady_clock::now();
+    trace::Span job_span("batch job");
+    job_span.setDetail(job.input_files[0]);
+
+    // Лишние файлы не отбрасываются молча: программа не компилируется
+    if (job.input_files.size() > MAX_INPUT_FILES) {
+        Error::ThrowConsole(7);
+        Error::out() << job.input_files[0] << ": " << job.input_files.size()
+                     << " files, at most " << MAX_INPUT_FILES << "\n";
+        Log::flush();
+        return result;
+    }
+
+    std::string input_files[MAX_INPUT_FILES];
+    for (size_t i = 0; i < job.input_files.size(); i++) {
+        input_files[i] = job.input_files[i];
+    }
+    // Журнал проверки кодировки у каждой программы свой
+    result.output_filename = input_files[0] + ".log";
+
+    try {
+        result.exit_code = runCompilation(call, input_files, result.output_filename, options);
+    }
+    catch (...) {
+        result.exit_code = -1;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    return result;
+}
+
+std::vector<JobResult> compileAll(const std::vector<Job>& jobs, short call,
+                                  const CallOptions& options, unsigned workers) {
+    std::vector<JobResult> results(jobs.size());
+    std::atomic<size_t> next_job(0);
+
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next_job++) < jobs.size()) {
+            results[index] = compileJob(jobs[index], call, options);
+        }
+    };
+
+    if (workers < 1) workers = 1;
+    if (workers > jobs.size()) workers = jobs.size();
+
+    std::vector<std::thread> pool;
+    for (unsigned i = 1; i < workers; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    return results;
+}
+
+int runBatch(int argc, char* argv[]) {
+    std::vector<Job> jobs;
+    CallOptions options;
+    short call = -1;
+    unsigned workers = std::thread::hardware_concurrency();
+
+    for (int i = 2; i < argc; i++) {
+        const char* arg = argv[i];
+        if (arg[0] == '@') {
+            if (!readResponseFile(arg + 1, jobs)) {
+                return -1;
+            }
+        } else if (strncmp(arg, "-j", 2) == 0) {
+            const char* count = arg[2] ? arg + 2 : (i + 1 < argc ? argv[++i] : "");
+            workers = static_cast<unsigned>(atoi(count));
+        } else if (arg[0] == '-') {
+            short code = getFlagCode(arg);
+            if (code != -1) {
+                call = code;
+            } else if (!applyOption(arg, options)) {
+                Error::ThrowConsole(3);
+                return -1;
+            }
+        } else {
+            Job job;
+            job.input_files.push_back(arg);
+            jobs.push_back(job);
+        }
+    }
+
+    if (jobs.empty()) {
+        Error::ThrowConsole(0);
+        return -1;
+    }
+    if (call == -1) {
+        Error::ThrowConsole(1);
+        return -1;
+    }
+
+    if (!options.trace_file.empty()) {
+        trace::start();
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<JobResult> results = compileAll(jobs, call, options, workers);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (!options.trace_file.empty()) {
+        trace::finish(options.trace_file);
+    }
+
+    size_t failed = 0;
+    std::cout << "\n=== BATCH SUMMARY ===\n";
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const JobResult& result = results[i];
+        if (result.exit_code != 0) {
+            failed++;
+        }
+        std::cout << std::left << std::setw(8) << (result.exit_code == 0 ? "[ok]" : "[fail]")
+                  << std::setw(30) << jobs[i].input_files[0]
+                  << " exit " << std::setw(4) << result.exit_code
+                  << std::fixed << std::setprecision(3) << result.seconds << " s";
+        if (result.exit_code == 0) {
+            std::cout << "  -> " << result.output_filename;
+        }
+        std::cout << "\n";
+    }
+    std::cout << "Programs: " << jobs.size()
+              << ", succeeded: " << (jobs.size() - failed)
+              << ", failed: " << failed
+              << ", total time: " << std::fixed << std::setprecision(3) << elapsed.count() << " s\n";
+
+    return failed == 0 ? 0 : 1;
+}
+
+} // namespace batch
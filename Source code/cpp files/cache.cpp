@@ -0,0 +1,181 @@
+#include <precomph.h>
+#include "cache.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
+
+namespace cache {
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static void hashBytes(uint64_t& hash, const std::string& data) {
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= FNV_PRIME;
+    }
+    // Длина как разделитель, чтобы "ab"+"c" и "a"+"bc" давали разные ключи
+    for (size_t size = data.size(), i = 0; i < sizeof(size); i++) {
+        hash ^= (size >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+}
+
+static bool readRaw(const std::string& filename, std::string& content) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+static bool writeRaw(const std::string& filename, const std::string& content) {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    file << content;
+    return file.good();
+}
+
+static std::string cacheDir() {
+    const char* dir = std::getenv("NGS_CACHE_DIR");
+    return (dir && *dir) ? dir : ".ngs_cache";
+}
+
+// Файл из менеджера текущей компиляции (там же его возьмет препроцессор)
+// или, вне компиляции, с диска как есть; false - файл недоступен или пуст
+static bool readSource(const std::string& filename, std::string& storage,
+                       const std::string*& content) {
+    if (FileWork::SourceManager* sources = FileWork::SourceManager::current()) {
+        content = &sources->text(sources->load(filename));
+        return !content->empty();
+    }
+    if (!readRaw(filename, storage)) {
+        return false;
+    }
+    content = &storage;
+    return true;
+}
+
+std::vector<std::string> scanIncludeNames(const std::string& source) {
+    std::vector<std::string> files;
+    size_t pos = 0;
+    while ((pos = source.find("##inaddition", pos)) != std::string::npos) {
+        size_t q1 = source.find('"', pos);
+        size_t q2 = (q1 == std::string::npos) ? q1 : source.find('"', q1 + 1);
+        pos += 12;
+        if (q2 != std::string::npos) {
+            files.push_back(source.substr(q1 + 1, q2 - q1 - 1));
+        }
+    }
+    return files;
+}
+
+// Отпечаток сборки компилятора: версия, компилятор, разрядность и сам
+// исполняемый файл (размер и время изменения). Записи другой сборки не
+// подходят, даже если NGS_VERSION не менялась
+static const std::string& buildStamp() {
+    static const std::string stamp = []() {
+        std::string text = std::string(NGS_VERSION) + " " + __DATE__ + " " + __TIME__;
+#ifdef __VERSION__
+        text += " " __VERSION__;
+#endif
+        text += " ptr" + std::to_string(sizeof(void*) * 8);
+
+        std::error_code ec;
+        fs::path exe = fs::read_symlink("/proc/self/exe", ec);
+        if (!ec) {
+            uintmax_t size = fs::file_size(exe, ec);
+            if (!ec) {
+                text += " " + std::to_string(size);
+            }
+            auto mtime = fs::last_write_time(exe, ec);
+            if (!ec) {
+                text += " " + std::to_string(mtime.time_since_epoch().count());
+            }
+        }
+        return text;
+    }();
+    return stamp;
+}
+
+std::string computeKey(const std::string& main_file, const std::string& mode,
+                       const DefineList& defines) {
+    std::string storage;
+    const std::string* content = nullptr;
+    if (!readSource(main_file, storage, content)) {
+        return "";
+    }
+    const std::string& source = *content;
+
+    uint64_t hash = FNV_OFFSET;
+    hashBytes(hash, buildStamp());
+    hashBytes(hash, mode);
+    hashBytes(hash, main_file);
+    hashBytes(hash, source);
+
+    // Все файлы, которые включит препроцессор, с вложенными. Без ключа,
+    // если какой-то из них не перекодирован: ошибку выдаст препроцессор
+    std::vector<std::string> included = IncludedFiles(main_file, source, defines);
+    FileWork::SourceManager* sources = FileWork::SourceManager::current();
+    if (sources && sources->transcodeFailed()) {
+        return "";
+    }
+    for (const auto& add_filename : included) {
+        std::string additional_storage;
+        const std::string* additional_code = nullptr;
+        hashBytes(hash, add_filename);
+        hashBytes(hash, readSource(add_filename, additional_storage, additional_code)
+                        ? *additional_code : std::string("\x01missing"));
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+    return key;
+}
+
+bool load(const std::string& key, Entry& entry) {
+    fs::path dir = fs::path(cacheDir()) / key;
+    return readRaw((dir / "name").string(), entry.output_filename) &&
+           readRaw((dir / "prep.txt").string(), entry.preprocessed_code) &&
+           readRaw((dir / "log_name").string(), entry.log_filename) &&
+           readRaw((dir / "log.txt").string(), entry.log) &&
+           readRaw((dir / "tokens.log").string(), entry.token_log) &&
+           readRaw((dir / "out.js").string(), entry.js) &&
+           readRaw((dir / "diagnostics.txt").string(), entry.diagnostics);
+}
+
+bool store(const std::string& key, const Entry& entry) {
+    static std::atomic<unsigned> counter(0);
+
+    // Запись во временный каталог и переименование, чтобы параллельные
+    // компиляции не видели неполную запись
+    fs::path dir = fs::path(cacheDir()) / key;
+    fs::path temp_dir = fs::path(cacheDir()) /
+        (key + ".tmp" + std::to_string(getpid()) + "_" + std::to_string(counter++));
+
+    std::error_code ec;
+    fs::create_directories(temp_dir, ec);
+    if (ec) return false;
+
+    bool written = writeRaw((temp_dir / "name").string(), entry.output_filename) &&
+                   writeRaw((temp_dir / "prep.txt").string(), entry.preprocessed_code) &&
+                   writeRaw((temp_dir / "log_name").string(), entry.log_filename) &&
+                   writeRaw((temp_dir / "log.txt").string(), entry.log) &&
+                   writeRaw((temp_dir / "tokens.log").string(), entry.token_log) &&
+                   writeRaw((temp_dir / "out.js").string(), entry.js) &&
+                   writeRaw((temp_dir / "diagnostics.txt").string(), entry.diagnostics);
+
+    if (written) {
+        fs::remove_all(dir, ec);
+        fs::rename(temp_dir, dir, ec);
+        written = !ec;
+    }
+    if (!written) {
+        fs::remove_all(temp_dir, ec);
+    }
+    return written;
+}
+
+} // namespace cache
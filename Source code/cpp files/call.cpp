@@ -1,4 +1,10 @@
 #include <precomph.h>
+#include "analysis.h"
+#include "artifacts.h"
+#include "cache.h"
+#include <atomic>
+#include <memory>
+#include <unistd.h>  // Для getpid()
 
 // Flags and codes:
 // -prep: preprocessor (code 0)
@@ -9,6 +15,24 @@
 // -pol: polish notation generation (code 5)
 // -tran: translation (code 6)
 // -run: run project (code 7)
+//
+// Options (after the flag):
+// -f <file>: output file
+// -saveprep: keep <name>_prep.txt for stages after preprocessing
+// -nocache: ignore the artifact cache for -tran and -run
+// -time-passes: print wall/CPU time per stage and counters
+// --stats-json[=file]: the same statistics as one JSON object
+// -trace=<file>: write a Chrome trace-event file (about://tracing, Perfetto)
+// -pipeline: run the lexer on its own thread, feeding the parser through
+//            a bounded token queue (-sem, -pol, -tran, -run)
+// -fused: preprocess and lex in one pass over the original files; tokens
+//         keep their file, line and column, no _prep.txt is produced
+// -emit=<list>: write only the listed artifacts of the chosen mode,
+//               any of tokens,ast,dot,rpn,js,report,prep (comma-separated)
+// -q: quiet, only errors and warnings
+// -v: verbose, adds FST and code generator debug output
+// -DNAME[=VALUE]: define a preprocessor macro (VALUE defaults to 1) for
+//                 ##when conditions; overrides ##perceive of the same name
 
 const char* flags[] = {"-prep", "-lex", "-syn", "-sem", "-pol", "-tran", "-run"};
 const short flagCodes[] = {0, 1, 2, 3, 4, 5, 6, 7};
@@ -23,7 +47,94 @@ short getFlagCode(const char* arg) {
 	return -1;
 }
 
-short processCall (int argc, char* argv[], string input_files[], string& output_file) {
+static bool parseEmitList(const char* list, CallOptions& options) {
+	static const char* names[] = {"tokens", "ast", "dot", "rpn", "js", "report"};
+	static const EmitKind kinds[] = {EMIT_TOKENS, EMIT_AST, EMIT_DOT, EMIT_RPN, EMIT_JS, EMIT_REPORT};
+
+	options.emit = 0;
+	std::istringstream iss(list);
+	std::string name;
+	while (std::getline(iss, name, ',')) {
+		if (name.empty()) {
+			continue;
+		}
+		if (name == "prep") {
+			options.save_prep = true;
+			continue;
+		}
+		bool known = false;
+		for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			if (name == names[i]) {
+				options.emit |= kinds[i];
+				known = true;
+			}
+		}
+		if (!known) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool applyOption(const char* arg, CallOptions& options) {
+	if (strcmp(arg, "-saveprep") == 0) {
+		options.save_prep = true;
+		return true;
+	}
+	if (strcmp(arg, "-nocache") == 0) {
+		options.use_cache = false;
+		return true;
+	}
+	if (strcmp(arg, "-time-passes") == 0) {
+		options.time_passes = true;
+		return true;
+	}
+	if (strncmp(arg, "--stats-json", 12) == 0 && (arg[12] == '\0' || arg[12] == '=')) {
+		options.stats_json = true;
+		options.stats_file = arg[12] ? arg + 13 : "";
+		return true;
+	}
+	if (strncmp(arg, "-trace=", 7) == 0 && arg[7] != '\0') {
+		options.trace_file = arg + 7;
+		return true;
+	}
+	if (strcmp(arg, "-pipeline") == 0) {
+		options.pipeline = true;
+		return true;
+	}
+	if (strcmp(arg, "-fused") == 0) {
+		options.fused = true;
+		return true;
+	}
+	if (strcmp(arg, "-utf8") == 0) {
+		options.utf8 = true;
+		return true;
+	}
+	if (strcmp(arg, "-q") == 0) {
+		options.log_level = Log::LEVEL_QUIET;
+		return true;
+	}
+	if (strcmp(arg, "-v") == 0) {
+		options.log_level = Log::LEVEL_DEBUG;
+		return true;
+	}
+	if (strncmp(arg, "-emit=", 6) == 0) {
+		return parseEmitList(arg + 6, options);
+	}
+	if (strncmp(arg, "-D", 2) == 0 && arg[2] != '\0' && arg[2] != '=') {
+		const char* eq = strchr(arg + 2, '=');
+		if (eq) {
+			options.defines.push_back({std::string(arg + 2, eq), std::string(eq + 1)});
+		} else {
+			options.defines.push_back({std::string(arg + 2), "1"});
+		}
+		return true;
+	}
+	return false;
+}
+
+short processCall (int argc, char* argv[], string input_files[], string& output_file,
+                   CallOptions& options) {
 	if (argc < 3) {	//There is no flag of file
 		Error::ThrowConsole(1);
 		return -1;
@@ -57,53 +168,579 @@ short processCall (int argc, char* argv[], string input_files[], string& output_
 		input_files[j - 1] = argv[j];
 		j++;
 	}
-	if (i+1 < argc) {
-		output_file = argv[i+1];
+	for (int k = i + 1; k < argc; k++) {
+		if (strcmp(argv[k], "-f") == 0) {
+			if (k + 1 >= argc) {
+				Error::ThrowConsole(2);
+				return -1;
+			}
+			output_file = argv[++k];
+		} else if (argv[k][0] == '-') {
+			if (!applyOption(argv[k], options)) {
+				Error::ThrowConsole(3);	//Incorrect option
+				return -1;
+			}
+		} else if (output_file.empty()) {
+			output_file = argv[k];
+		}
 	}
 
 	return code;
 }
 
 bool performPreprocessing(std::string input_files[], std::string& output_filename, 
-                        std::string& preprocessed_code) {
-							std::cout << "Preprocessing...\n";
-    short prep_result = Preprocess(input_files, output_filename);
+                        std::string& preprocessed_code, const CallOptions& options,
+                        PreprocessLog* log) {
+							Log::info() << "Preprocessing...\n";
+    TRACE_SCOPE("preprocess");
+    // Буфер передается лексеру напрямую, без повторного чтения _prep.txt
+    short prep_result = Preprocess(input_files, output_filename, preprocessed_code,
+                                   options.save_prep, options.defines, log);
     
     if (prep_result != 0) {
-        std::cout << "Preprocessing failed with error code: " << prep_result << std::endl;
+        Error::out() << "Preprocessing failed with error code: " << prep_result << std::endl;
         return false;
     }
     
-    std::cout << "Preprocessing successful!\n";
-    std::cout << "Output file: " << output_filename << std::endl;
+    Log::info() << "Preprocessing successful!\n";
     
-    if (!FileWork::fileExists(output_filename)) {
-        std::cout << "Error: Preprocessed file not found: " << output_filename << "\n";
-        return false;
-    }
-    
-    std::cout << "Reading preprocessed code...\n";
-    preprocessed_code = FileWork::ReadFile(output_filename);
     if (preprocessed_code.empty()) {
-        std::cout << "Error: Preprocessed file is empty: " << output_filename << "\n";
+        Error::out() << "Error: Preprocessed code is empty: " << output_filename << "\n";
         return false;
     }
     
-    std::cout << "File read successfully, size: " << preprocessed_code.size() << " bytes\n";
+    Log::info() << "Preprocessed code size: " << preprocessed_code.size() << " bytes\n";
     return true;
 }
 
 bool performLexicalAnalysis(const std::string& source_code, const std::string& filename,
                            std::vector<lexan::Token>& tokens) {
-		std::cout << "Lexical analysis...\n";
+		Log::info() << "Lexical analysis...\n";
+		TRACE_SCOPE("lex");
 		lexan::Lexer lexer(source_code, filename);
 		tokens = lexer.tokenize();
 		
 		if (tokens.empty()) {
-			std::cout << "Error: No tokens generated\n";
+			Error::out() << "Error: No tokens generated\n";
 			return false;
 		}
 		
-		std::cout << "Tokens generated: " << tokens.size() << std::endl;
+		Log::info() << "Tokens generated: " << tokens.size() << "\n";
 		return true;
-	}
\ No newline at end of file
+	}
+
+bool performFusedFrontEnd(std::string input_files[], std::string& output_filename,
+                          std::vector<lexan::Token>& tokens, const CallOptions& options,
+                          PreprocessLog* log) {
+    Log::info() << "Preprocessing and lexical analysis (fused)...\n";
+    TRACE_SCOPE("fused front end");
+    std::vector<std::string> files;
+    short result = PreprocessTokens(input_files, output_filename, tokens, files, options.defines,
+                                    log);
+    if (result != 0) {
+        Error::out() << "Preprocessing failed with error code: " << result << std::endl;
+        return false;
+    }
+    if (tokens.empty()) {
+        Error::out() << "Error: No tokens generated\n";
+        return false;
+    }
+    Log::info() << "Tokens generated: " << tokens.size() << " from " << files.size() << " file(s)\n";
+    return true;
+}
+
+// Токены программы: препроцессор и лексер по очереди или, с -fused,
+// одним проходом. source_code - препроцессированный текст (без -fused),
+// log - копия журнала препроцессора, если нужна
+static bool produceTokens(std::string input_files[], std::string& output_filename,
+                          const CallOptions& options, std::string& source_code,
+                          std::vector<lexan::Token>& tokens, PreprocessLog* log = nullptr) {
+    if (options.fused) {
+        return performFusedFrontEnd(input_files, output_filename, tokens, options, log);
+    }
+    return performPreprocessing(input_files, output_filename, source_code, options, log) &&
+           performLexicalAnalysis(source_code, output_filename, tokens);
+}
+
+// Препроцессор, лексический анализ и создание парсера. С -pipeline лексер
+// работает в отдельном потоке и передает токены парсеру через ограниченную
+// очередь, поток токенов целиком не строится - поэтому конвейер
+// используется, только если журнал токенов не нужен, и не вместе с -fused.
+// В entry (запись кэша) заполняются журнал препроцессора и, если поток
+// токенов построен, журнал токенов. Токены переносятся в парсер без
+// копирования. source_code должен жить дольше парсера
+static parser::Parser* createParser(std::string input_files[], std::string& filename,
+                                    const CallOptions& options, bool write_token_log,
+                                    cache::Entry* entry, std::string& source_code,
+                                    std::vector<lexan::Token>& tokens) {
+    PreprocessLog log;
+    PreprocessLog* keep_log = entry ? &log : nullptr;
+    if (options.pipeline && !options.fused && !write_token_log) {
+        if (!performPreprocessing(input_files, filename, source_code, options, keep_log)) {
+            return nullptr;
+        }
+        if (entry) {
+            entry->log_filename = std::move(log.filename);
+            entry->log = std::move(log.content);
+        }
+        Log::info() << "Lexical analysis (pipelined)...\n";
+        return new parser::Parser(source_code, filename);
+    }
+
+    if (!produceTokens(input_files, filename, options, source_code, tokens, keep_log)) {
+        return nullptr;
+    }
+    if (entry) {
+        entry->log_filename = std::move(log.filename);
+        entry->log = std::move(log.content);
+        entry->token_log = parser::tokenLogBody(tokens);
+    }
+    if (write_token_log) {
+        std::string token_log_filename = filename + ".tokens.log";
+        parser::writeTokenLog(entry ? entry->token_log : parser::tokenLogBody(tokens),
+                              filename, token_log_filename);
+    }
+    return new parser::Parser(std::move(tokens));
+}
+
+// Этапы от препроцессора до генерации JavaScript для -tran и -run.
+// Для неизмененных входных файлов результат берется из кэша (cache.h),
+// после полного прохода - сохраняется в него
+static bool produceJavaScript(short call, std::string input_files[], std::string& output_filename,
+                              const CallOptions& options, std::string& js_code) {
+    std::string key;
+    if (options.use_cache) {
+        // Определения -D меняют результат - входят в ключ
+        std::string mode = call == 5 ? "tran" : "run";
+        if (options.fused) {
+            mode += " -fused";
+        }
+        if (options.utf8) {
+            mode += " -utf8";
+        }
+        for (const auto& define : options.defines) {
+            mode += " -D" + define.first + "=" + define.second;
+        }
+        key = cache::computeKey(input_files[0], mode, options.defines);
+    }
+
+    // Запись, сделанная с -pipeline, не хранит журнал токенов: если он
+    // нужен, программа компилируется заново
+    bool token_log = call == 5 && options.emits(EMIT_TOKENS);
+    cache::Entry entry;
+    bool hit;
+    {
+        TRACE_SCOPE("cache lookup");
+        hit = !key.empty() && cache::load(key, entry);
+    }
+    if (hit && token_log && entry.token_log.empty()) {
+        hit = false;
+        entry = cache::Entry();
+    }
+    if (hit) {
+        // Те же артефакты, что и при полном проходе
+        Log::info() << "Cache hit: " << key << "\n";
+        output_filename = entry.output_filename;
+        FileWork::WriteFile(entry.log_filename, entry.log);
+        if (options.save_prep) {
+            FileWork::WriteFile(output_filename, entry.preprocessed_code);
+        }
+        if (token_log) {
+            parser::writeTokenLog(entry.token_log, output_filename,
+                                  output_filename + ".tokens.log");
+        }
+        Error::out() << entry.diagnostics;
+        js_code = entry.js;
+        return true;
+    }
+
+    std::string source_code;
+    std::vector<lexan::Token> tokens;
+    std::unique_ptr<parser::Parser> parser(createParser(input_files, output_filename, options,
+                                                        token_log, key.empty() ? nullptr : &entry,
+                                                        source_code, tokens));
+    if (!parser) {
+        return false;
+    }
+    
+    // Синтаксический анализ
+    if (!parser->parse()) {
+        Error::out() << (call == 5 ? "Parsing failed! Cannot generate code.\n"
+                                : "Parsing failed! Cannot generate code for execution.\n");
+        return false;
+    }
+    
+    // Ошибки и предупреждения анализа сохраняются в кэш, чтобы попадание
+    // выводило то же, что и полный проход
+    std::ostringstream diagnostics;
+    {
+        Error::OutputScope capture(diagnostics);
+        codegen::CodeGenerator generator;
+        if (call == 5) {
+            // Семантический анализ
+            semantic::SemanticAnalyzer analyzer;
+            bool semantic_ok;
+            {
+                TRACE_SCOPE("semantic");
+                semantic_ok = analyzer.analyze(parser->get_ast());
+            }
+            if (!semantic_ok) {
+                Error::out() << "Semantic analysis failed! Code generation may produce incorrect results.\n";
+            }
+            TRACE_SCOPE("codegen");
+            js_code = generator.generate(parser->get_ast(), &analyzer);
+        } else {
+            TRACE_SCOPE("codegen");
+            js_code = generator.generate(parser->get_ast());
+        }
+    }
+    entry.diagnostics = diagnostics.str();
+    Error::out() << entry.diagnostics;
+
+    if (!key.empty()) {
+        TRACE_SCOPE("cache store");
+        entry.output_filename = output_filename;
+        entry.preprocessed_code = source_code;
+        entry.js = js_code;
+        cache::store(key, entry);
+    }
+    return true;
+}
+
+static int compileStages(short call, std::string input_files[], std::string& output_filename,
+                         const CallOptions& options) {
+    static std::atomic<unsigned> temp_counter(0);
+    trace::Span compile_span("compile");
+    compile_span.setDetail(input_files[0]);
+
+    // Каждый входной файл читается один раз: тот же буфер получают
+    // препроцессор, ключ кэша и загрузка файлов ##inaddition. С -utf8 файлы
+    // в UTF-8 перекодируются при чтении
+    FileWork::SourceManager sources(options.utf8);
+    FileWork::SourceManager::Scope sources_scope(&sources);
+
+    for (int i = 0; i < 10; i++) {
+        if (input_files[i].empty()) {
+            break;
+        }
+        TRACE_SCOPE("encoding check");
+        const std::string& text = sources.text(sources.load(input_files[i]));
+        if (sources.transcodeFailed()) {
+            Error::out() << "Compilation Terminated\n";
+            return -1;
+        }
+        if (!isWindows1251(text, output_filename)) {
+            Error::ThrowConsole(998);
+            Error::out() << "Compilation Terminated\n";
+            return -1;
+        }
+    }
+
+    switch(call) {
+        case 0: // -prep
+            {
+                Log::info() << "=== PREPROCESSING ONLY ===\n";
+                std::string preprocessed_code;
+                short prep_result = Preprocess(input_files, output_filename, preprocessed_code,
+                                               true, options.defines);
+                if (prep_result != 0) {
+                    Error::out() << "Preprocessing failed with error code: " << prep_result << std::endl;
+                    return 1;
+                }
+                Log::info() << "Preprocessed code saved to: " << output_filename << "\n";
+                break; 
+            }   
+        case 1: // -lex
+            {
+                Log::info() << "=== LEXICAL ANALYSIS ===\n";
+                std::string source_code;
+                std::vector<lexan::Token> tokens;
+                if (!produceTokens(input_files, output_filename, options, source_code, tokens)) {
+                    return 1;
+                }
+                
+                if (options.emits(EMIT_TOKENS)) {
+                    std::string token_log_filename = output_filename + ".tokens.log";
+                    parser::writeTokenLog(tokens, output_filename, token_log_filename);
+                    
+                    std::string token_filename = output_filename + ".tokens.txt";
+                    if (lexan::Lexer::generate_token_file(tokens, token_filename)) {
+                        Log::info() << "Standard token file saved to: " << token_filename << "\n";
+                    }
+                }
+                
+                Log::info() << "\nLexical analysis completed successfully!\n";
+                break;
+            }
+        case 2: // -syn
+            {
+                Log::info() << "=== SYNTAX ANALYSIS ===\n";
+                std::string source_code;
+                std::vector<lexan::Token> tokens;
+                if (!produceTokens(input_files, output_filename, options, source_code, tokens)) {
+                    return 1;
+                }
+                
+                if (options.emits(EMIT_TOKENS)) {
+                    std::string token_log_filename = output_filename + ".tokens.log";
+                    parser::writeTokenLog(tokens, output_filename, token_log_filename);
+                }
+                
+                parser::Parser parser(tokens);
+                if (!parser::performSyntaxAnalysis(tokens, output_filename, parser,
+                                                   options.emits(EMIT_AST), options.emits(EMIT_DOT))) {
+                    return 1;
+                }
+                
+                Log::info() << "\nSyntax analysis completed successfully!\n";
+                if (options.emits(EMIT_AST) || options.emits(EMIT_DOT)) {
+                    Log::info() << "AST files generated:\n";
+                }
+                if (options.emits(EMIT_AST)) {
+                    Log::info() << "  - " << output_filename << ".ast.txt (text representation)\n";
+                }
+                if (options.emits(EMIT_DOT)) {
+                    Log::info() << "  - " << output_filename << ".ast.dot (Graphviz DOT format)\n";
+                }
+                break;
+            }
+        case 3: // -sem
+            {
+                Log::info() << "=== SEMANTIC ANALYSIS ===\n";
+                std::string source_code;
+                std::vector<lexan::Token> tokens;
+                std::unique_ptr<parser::Parser> parser(createParser(input_files, output_filename, options,
+                                                                    options.emits(EMIT_TOKENS), nullptr,
+                                                                    source_code, tokens));
+                if (!parser) {
+                    return 1;
+                }
+                
+                // Синтаксический анализ
+                if (!parser->parse()) {
+                    Error::out() << "Parsing failed! Cannot perform semantic analysis.\n";
+                    return 1;
+                }
+                
+                // Семантический анализ
+                semantic::SemanticAnalyzer analyzer;
+                if (!performSemanticAnalysis(parser->get_ast(), output_filename, analyzer,
+                                             options.emits(EMIT_REPORT))) {
+                    return 1;
+                }
+                
+                Log::info() << "\nSemantic analysis completed successfully!\n";
+                break;
+            }
+        case 4: // -pol (польская нотация)
+            {
+                Log::info() << "=== REVERSE POLISH NOTATION CONVERSION ===\n";
+                std::string source_code;
+                std::vector<lexan::Token> tokens;
+                std::unique_ptr<parser::Parser> parser(createParser(input_files, output_filename, options,
+                                                                    options.emits(EMIT_TOKENS), nullptr,
+                                                                    source_code, tokens));
+                if (!parser) {
+                    return 1;
+                }
+                
+                // Синтаксический анализ
+                if (!parser->parse()) {
+                    Error::out() << "Parsing failed! Cannot perform RPN conversion.\n";
+                    return 1;
+                }
+                
+                // RPN конверсия
+                rpn::RPNConverter converter;
+                if (!performRPNConversion(parser->get_ast(), output_filename, converter,
+                                          options.emits(EMIT_RPN))) {
+                    return 1;
+                }
+                
+                Log::info() << "\nRPN conversion completed successfully!\n";
+                break;
+            }
+        case 5: // -tran (трансляция в JS)
+            {
+                Log::info() << "=== CODE GENERATION ===\n";
+                std::string js_code;
+                if (!produceJavaScript(call, input_files, output_filename, options, js_code)) {
+                    return 1;
+                }
+                
+                // Сохранение кода в файл
+                std::string js_filename = output_filename + ".js";
+                if (options.emits(EMIT_JS)) {
+                    TRACE_SCOPE("write js");
+                    if (!artifacts::write(js_filename, js_code)) {
+                        Error::out() << "Error: Could not create JavaScript file\n";
+                        return 1;
+                    }
+                }
+                
+                Log::info() << "Code generation successful!\n";
+                if (options.emits(EMIT_JS)) {
+                    Log::info() << "JavaScript code saved to: " << js_filename << "\n";
+                }
+                
+                // Показать часть сгенерированного кода
+                if (Log::level() >= Log::LEVEL_INFO) {
+                    Log::info() << "\n=== Generated JavaScript (first 50 lines) ===\n";
+                    std::istringstream iss(js_code);
+                    std::string line;
+                    int line_count = 0;
+                    while (std::getline(iss, line) && line_count < 50) {
+                        Log::info() << line << "\n";
+                        line_count++;
+                    }
+                }
+                break;
+            }
+        case 6: // -run (запуск сгенерированного кода)
+            {
+                Log::info() << "=== CODE EXECUTION ===\n";
+                
+                // Сначала проверяем, установлен ли Node.js
+                Log::info() << "Checking Node.js installation...\n";
+                Log::flush();
+                int node_check = system("which node > /dev/null 2>&1");
+                if (node_check != 0) {
+                    Error::out() << "Error: Node.js is not installed!\n";
+                    Error::out() << "Install Node.js with:\n";
+                    Error::out() << "  sudo apt update\n";
+                    Error::out() << "  sudo apt install nodejs npm\n";
+                    return 1;
+                }
+                
+                std::string js_code;
+                if (!produceJavaScript(call, input_files, output_filename, options, js_code)) {
+                    return 1;
+                }
+                
+                // Создаем временный файл
+                std::string temp_js_filename = "/tmp/mycompiler_" + std::to_string(getpid()) + "_" +
+                                                   std::to_string(temp_counter++) + ".js";
+                
+                // node читает файл сразу - запись не откладывается
+                if (!artifacts::writeNow(temp_js_filename, js_code)) {
+                    Error::out() << "Error: Could not create temporary file\n";
+                    return 1;
+                }
+                
+                // Запуск сгенерированного JavaScript кода
+                Log::info() << "\nExecuting generated JavaScript code...\n";
+                Log::info() << "========================================\n";
+                
+                // Собираем команду для выполнения
+                std::string command = "node \"" + temp_js_filename + "\"";
+                
+                // Выполняем команду
+                int result;
+                {
+                    TRACE_SCOPE("node");
+                    Log::flush();
+                    result = system(command.c_str());
+                }
+                
+                Log::info() << "========================================\n";
+                
+                // Удаляем временный файл
+                std::remove(temp_js_filename.c_str());
+                
+                if (result == 0) {
+                    Log::info() << "Execution completed successfully!\n";
+                } else {
+                    Error::out() << "Execution failed with exit code: " << result << "\n";
+                }
+                break;
+            }
+        default:
+            Error::out() << "Unknown command: " << call << "\n";
+            Error::out() << "Available commands:\n";
+            Error::out() << "  -prep  : Preprocessing only\n";
+            Error::out() << "  -lex   : Lexical analysis + tokens\n";
+            Error::out() << "  -syn   : Syntax analysis + AST\n";
+            Error::out() << "  -sem   : Semantic analysis\n";
+            Error::out() << "  -pol   : Reverse Polish Notation conversion\n";
+            Error::out() << "  -tran  : Code generation to JavaScript\n";
+            Error::out() << "  -run   : Execute generated JavaScript code\n";
+            return 1;
+    }
+
+    return 0;
+}
+
+// Выходные файлы этапов пишет фоновый поток (artifacts.h); программа
+// считается скомпилированной, когда все они записаны
+static int compileProgram(short call, std::string input_files[], std::string& output_filename,
+                          const CallOptions& options) {
+    artifacts::Group written;
+    int result;
+    {
+        artifacts::Group::Scope written_scope(&written);
+        result = compileStages(call, input_files, output_filename, options);
+    }
+    TRACE_SCOPE("wait artifacts");
+    if (!written.wait() && result == 0) {
+        result = 1;
+    }
+    return result;
+}
+
+static int compileWithStats(short call, std::string input_files[], std::string& output_filename,
+                            const CallOptions& options) {
+    if (!options.time_passes && !options.stats_json) {
+        return compileProgram(call, input_files, output_filename, options);
+    }
+
+    stats::Collector collector;
+    stats::active = &collector;
+    auto start = std::chrono::steady_clock::now();
+    int result;
+    try {
+        result = compileProgram(call, input_files, output_filename, options);
+    }
+    catch (...) {
+        stats::active = nullptr;
+        throw;
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    collector.total_wall_ms = elapsed.count();
+    stats::active = nullptr;
+
+    if (options.time_passes) {
+        collector.print(Error::out());
+    }
+    if (options.stats_json) {
+        if (options.stats_file.empty()) {
+            collector.printJson(Error::out(), input_files[0]);
+        } else {
+            std::ofstream json_file(options.stats_file);
+            if (!json_file.is_open()) {
+                Error::out() << "Error: Could not create statistics file: " << options.stats_file << "\n";
+            } else {
+                collector.printJson(json_file, input_files[0]);
+            }
+        }
+    }
+    return result;
+}
+
+// Полный цикл обработки одной программы в выбранном режиме.
+// Не использует глобального состояния, поэтому может выполняться
+// одновременно для нескольких программ (см. batch.cpp).
+// Сообщения программы выводятся одним блоком по завершении
+int runCompilation(short call, std::string input_files[], std::string& output_filename,
+                   const CallOptions& options) {
+    Log::LevelScope level(options.log_level);
+    int result;
+    try {
+        result = compileWithStats(call, input_files, output_filename, options);
+    }
+    catch (...) {
+        Log::flush();
+        throw;
+    }
+    Log::flush();
+    return result;
+}
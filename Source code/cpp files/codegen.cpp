@@ -1,4 +1,6 @@
 #include "codegen.h"
+#include "stats.h"
+#include "artifacts.h"
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -65,6 +67,7 @@ std::string CodeGenerator::get_js_type(const std::string& type) {
 }
 
 std::string CodeGenerator::generate(parser::ASTNode* ast, semantic::SemanticAnalyzer* analyzer) {
+    stats::ScopedTimer timer(stats::STAGE_CODEGEN);
     this->semantic_analyzer = analyzer;
     code.str("");
     current_indent = "";
@@ -73,7 +76,8 @@ std::string CodeGenerator::generate(parser::ASTNode* ast, semantic::SemanticAnal
     
     // Добавляем JavaScript header
     code << "// Generated JavaScript code from custom language\n";
-    code << "// Date: " << __DATE__ << " " << __TIME__ << "\n\n";
+    // Без даты сборки: вывод должен побайтно совпадать для одинаковых входных данных
+    code << "\n";
     
     // Добавляем хелпер-функции для встроенных операций
     code << "// Helper functions for built-in operations\n";
@@ -111,7 +115,9 @@ std::string CodeGenerator::generate(parser::ASTNode* ast, semantic::SemanticAnal
     // Генерируем код программы
     generate_program(ast);
     
-    return code.str();
+    std::string js_code = code.str();
+    stats::count(stats::COUNTER_BYTES_EMITTED, js_code.size());
+    return js_code;
 }
 
 void CodeGenerator::generate_program(parser::ASTNode* node) {
@@ -207,14 +213,14 @@ void CodeGenerator::generate_procedure_decl(parser::ASTNode* node) {
     if (!node) return;
     
     std::string proc_name = node->value;
-    std::cout << "[DEBUG] Generating procedure: " << proc_name << std::endl;
+    Log::debug() << "[DEBUG] Generating procedure: " << proc_name << "\n";
     
     // Проверим структуру узла процедуры
-    std::cout << "[DEBUG] Procedure has " << node->children.size() << " children\n";
+    Log::debug() << "[DEBUG] Procedure has " << node->children.size() << " children\n";
     for (size_t i = 0; i < node->children.size(); i++) {
-        std::cout << "[DEBUG] Child " << i << ": type = " 
-                  << static_cast<int>(node->children[i]->type) 
-                  << ", value = " << node->children[i]->value << std::endl;
+        Log::debug() << "[DEBUG] Child " << i << ": type = " 
+                     << static_cast<int>(node->children[i]->type) 
+                     << ", value = " << node->children[i]->value << "\n";
     }
     
     // Генерируем сигнатуру процедуры (функция без возвращаемого значения в JS)
@@ -567,11 +573,7 @@ void CodeGenerator::generate_block(parser::ASTNode* node) {
 }
 
 void CodeGenerator::save_to_file(const std::string& filename) {
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        file << code.str();
-        file.close();
-    } else {
+    if (!artifacts::write(filename, code.str())) {
         std::cerr << "Error: Could not save generated code to " << filename << std::endl;
     }
 }
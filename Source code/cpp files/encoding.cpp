@@ -1,4 +1,19 @@
 #include <precomph.h>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NGS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NGS_TARGET_AVX2
+#else
+#define NGS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NGS_SSE2 1
+#endif
+#endif
 
 static bool allowed[256];
 
@@ -23,35 +38,289 @@ void initWindows1251Table() {
     }
 }
 
-bool isWindows1251(const std::string& text, const std::string& logfile_name) {
-    static bool initialized = false;
-    if (!initialized) {
-        initWindows1251Table();
-        initialized = true;
+// Поиск первого недопустимого байта: индекс или n, если все допустимы.
+// Векторные варианты проверяют 16 (SSE2) или 32 (AVX2) байта за шаг и
+// переходят к таблице allowed только в блоке с недопустимым байтом
+static size_t findInvalidScalar(const char* data, size_t from, size_t n) {
+    for (size_t i = from; i < n; i++) {
+        if (!allowed[static_cast<unsigned char>(data[i])]) {
+            return i;
+        }
+    }
+    return n;
+}
+
+#ifdef NGS_X86
+// Недопустимы управляющие 0x00-0x1F, кроме \t \n \r, и 0x7F. Байты
+// 0x80-0xFF при знаковом сравнении отрицательны и отсекаются cmpgt(-1)
+static size_t findInvalidSSE2(const char* data, size_t n) {
+    const __m128i space = _mm_set1_epi8(0x20);
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i control = _mm_and_si128(_mm_cmplt_epi8(v, space), _mm_cmpgt_epi8(v, minus_one));
+        __m128i whitespace = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, lf)),
+                                          _mm_cmpeq_epi8(v, cr));
+        __m128i bad = _mm_or_si128(_mm_andnot_si128(whitespace, control), _mm_cmpeq_epi8(v, del));
+        if (_mm_movemask_epi8(bad) != 0) {
+            return findInvalidScalar(data, i, i + 16);
+        }
+    }
+    return findInvalidScalar(data, i, n);
+}
+
+NGS_TARGET_AVX2
+static size_t findInvalidAVX2(const char* data, size_t n) {
+    const __m256i space = _mm256_set1_epi8(0x20);
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(space, v), _mm256_cmpgt_epi8(v, minus_one));
+        __m256i whitespace = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, tab),
+                                                             _mm256_cmpeq_epi8(v, lf)),
+                                             _mm256_cmpeq_epi8(v, cr));
+        __m256i bad = _mm256_or_si256(_mm256_andnot_si256(whitespace, control),
+                                      _mm256_cmpeq_epi8(v, del));
+        if (_mm256_movemask_epi8(bad) != 0) {
+            return findInvalidScalar(data, i, i + 32);
+        }
+    }
+    return findInvalidScalar(data, i, n);
+}
+
+static bool cpuHasAVX2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    // OSXSAVE и сохранение регистров YMM операционной системой
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static size_t findInvalidPortable(const char* data, size_t n) {
+    return findInvalidScalar(data, 0, n);
+}
+
+typedef size_t (*InvalidByteFinder)(const char* data, size_t n);
+
+// Вариант выбирается один раз по возможностям процессора
+static InvalidByteFinder selectFinder() {
+#ifdef NGS_X86
+    if (cpuHasAVX2()) {
+        return findInvalidAVX2;
     }
+#ifdef NGS_SSE2
+    return findInvalidSSE2;
+#endif
+#endif
+    return findInvalidPortable;
+}
+
+bool checkWindows1251(const std::string& text, std::string& log_content) {
+    stats::ScopedTimer timer(stats::STAGE_ENCODING);
+    static const bool initialized = (initWindows1251Table(), true);
+    (void)initialized;
+    static const InvalidByteFinder find_invalid = selectFinder();
 
-    std::string log_content = "Encoding check:\n";
+    log_content.append("Encoding check:\n");
     
-    for (size_t i = 0; i < text.size(); i++) {
+    size_t i = find_invalid(text.data(), text.size());
+    if (i < text.size()) {
         unsigned char c = static_cast<unsigned char>(text[i]);
-        
-        if (allowed[c]) {
-            continue;
-        }
-        
-        int row = FileWork::FindRow(text, i);
-        int col = FileWork::FindCol(text, i);
+        int row, col;
+        FileWork::LineIndex(text).locate(i, row, col);
         std::string message = "Invalid character (code " + std::to_string((int)c) +
                               ") at row " + std::to_string(row) +
                               ", col " + std::to_string(col) + "\n";
         
         log_content.append(message);
-        std::cout << message;
-        FileWork::WriteFile(logfile_name, log_content);
+        Error::out() << message;
         return false;
     }
     
     log_content.append("All characters are valid Windows-1251.\n");
-    FileWork::WriteFile(logfile_name, log_content);
     return true;
 }
+
+bool isWindows1251(const std::string& text, const std::string& logfile_name) {
+    std::string log_content;
+    bool valid = checkWindows1251(text, log_content);
+    FileWork::WriteFile(logfile_name, log_content);
+    return valid;
+}
+
+// Символы Unicode вне диапазона А-я (U+0410-U+044F) с кодом в Windows-1251,
+// по возрастанию кода. Байт 0x98 в Windows-1251 не определен
+static const struct {
+    unsigned short code;
+    unsigned char byte;
+} unicode_to_1251[] = {
+    {0x00A0, 0xA0}, {0x00A4, 0xA4}, {0x00A6, 0xA6}, {0x00A7, 0xA7}, {0x00A9, 0xA9},
+    {0x00AB, 0xAB}, {0x00AC, 0xAC}, {0x00AD, 0xAD}, {0x00AE, 0xAE}, {0x00B0, 0xB0},
+    {0x00B1, 0xB1}, {0x00B5, 0xB5}, {0x00B6, 0xB6}, {0x00B7, 0xB7}, {0x00BB, 0xBB},
+    {0x0401, 0xA8}, {0x0402, 0x80}, {0x0403, 0x81}, {0x0404, 0xAA}, {0x0405, 0xBD},
+    {0x0406, 0xB2}, {0x0407, 0xAF}, {0x0408, 0xA3}, {0x0409, 0x8A}, {0x040A, 0x8C},
+    {0x040B, 0x8E}, {0x040C, 0x8D}, {0x040E, 0xA1}, {0x040F, 0x8F}, {0x0451, 0xB8},
+    {0x0452, 0x90}, {0x0453, 0x83}, {0x0454, 0xBA}, {0x0455, 0xBE}, {0x0456, 0xB3},
+    {0x0457, 0xBF}, {0x0458, 0xBC}, {0x0459, 0x9A}, {0x045A, 0x9C}, {0x045B, 0x9E},
+    {0x045C, 0x9D}, {0x045E, 0xA2}, {0x045F, 0x9F}, {0x0490, 0xA5}, {0x0491, 0xB4},
+    {0x2013, 0x96}, {0x2014, 0x97}, {0x2018, 0x91}, {0x2019, 0x92}, {0x201A, 0x82},
+    {0x201C, 0x93}, {0x201D, 0x94}, {0x201E, 0x84}, {0x2020, 0x86}, {0x2021, 0x87},
+    {0x2022, 0x95}, {0x2026, 0x85}, {0x2030, 0x89}, {0x2039, 0x8B}, {0x203A, 0x9B},
+    {0x20AC, 0x88}, {0x2116, 0xB9}, {0x2122, 0x99}
+};
+
+// Байт Windows-1251 для символа не из ASCII или -1
+static int toWindows1251(unsigned code) {
+    if (code >= 0x0410 && code <= 0x044F) {
+        return 0xC0 + static_cast<int>(code - 0x0410);
+    }
+    size_t lo = 0, hi = sizeof(unicode_to_1251) / sizeof(unicode_to_1251[0]);
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (unicode_to_1251[mid].code < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < sizeof(unicode_to_1251) / sizeof(unicode_to_1251[0]) && unicode_to_1251[lo].code == code) {
+        return unicode_to_1251[lo].byte;
+    }
+    return -1;
+}
+
+// Многобайтная последовательность UTF-8 в начале s: длина или 0, если она
+// некорректна (в том числе избыточная запись и суррогаты)
+static size_t decodeUTF8(const unsigned char* s, size_t n, unsigned& code) {
+    unsigned char c = s[0];
+    unsigned char lo = 0x80, hi = 0xBF;   // Допустимый диапазон второго байта
+    size_t length;
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+        code = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        code = c & 0x0F;
+        if (c == 0xE0) lo = 0xA0;
+        if (c == 0xED) hi = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        code = c & 0x07;
+        if (c == 0xF0) lo = 0x90;
+        if (c == 0xF4) hi = 0x8F;
+    } else {
+        return 0;
+    }
+    if (n < length || s[1] < lo || s[1] > hi) {
+        return 0;
+    }
+    code = (code << 6) | (s[1] & 0x3F);
+    for (size_t k = 2; k < length; k++) {
+        if ((s[k] & 0xC0) != 0x80) {
+            return 0;
+        }
+        code = (code << 6) | (s[k] & 0x3F);
+    }
+    return length;
+}
+
+// Копирование ASCII блоками по 16 байт, пока в блоке нет байтов >= 0x80.
+// Запись не обгоняет чтение (o <= i), поэтому блок помещается в dst
+static void copyASCII(const unsigned char* in, size_t n, size_t& i, char* dst, size_t& o) {
+    while (i + 16 <= n) {
+#ifdef NGS_SSE2
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        if (_mm_movemask_epi8(v) != 0) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + o), v);
+#else
+        uint64_t words[2];
+        std::memcpy(words, in + i, 16);
+        if (((words[0] | words[1]) & 0x8080808080808080ULL) != 0) {
+            break;
+        }
+        std::memcpy(dst + o, words, 16);
+#endif
+        i += 16;
+        o += 16;
+    }
+    while (i < n && in[i] < 0x80) {
+        dst[o++] = static_cast<char>(in[i++]);
+    }
+}
+
+SourceEncoding decodeSource(std::string_view text, std::string& out,
+                            size_t& bad_pos, unsigned& bad_code) {
+    stats::ScopedTimer timer(stats::STAGE_ENCODING);
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(text.data());
+    size_t n = text.size();
+    // Перекодированный текст не длиннее исходного
+    out.resize(n);
+    char* dst = &out[0];
+    size_t i = 0, o = 0;
+    bool utf8 = false;
+    bad_pos = std::string::npos;
+    bad_code = 0;
+
+    if (n >= 3 && in[0] == 0xEF && in[1] == 0xBB && in[2] == 0xBF) {
+        i = 3;
+        utf8 = true;
+    }
+    while (true) {
+        copyASCII(in, n, i, dst, o);
+        if (i >= n) {
+            break;
+        }
+        unsigned code;
+        size_t length = decodeUTF8(in + i, n - i, code);
+        if (length == 0) {
+            // Не UTF-8. До первого не-ASCII символа out совпадает с text
+            if (utf8) {
+                out.assign(text.data(), n);
+            } else {
+                std::memcpy(dst + o, in + i, n - i);
+            }
+            return SOURCE_WINDOWS1251;
+        }
+        utf8 = true;
+        int byte = toWindows1251(code);
+        if (byte < 0) {
+            // Проход продолжается: дальше текст может оказаться не UTF-8
+            if (bad_pos == std::string::npos) {
+                bad_pos = i;
+                bad_code = code;
+            }
+            byte = '?';
+        }
+        dst[o++] = static_cast<char>(byte);
+        i += length;
+    }
+
+    if (!utf8) {
+        return SOURCE_WINDOWS1251;
+    }
+    out.resize(o);
+    return bad_pos == std::string::npos ? SOURCE_UTF8 : SOURCE_UNMAPPABLE;
+}
@@ -18,12 +18,17 @@ namespace Error {
         error_info(3, "Некорректный флаг"),
         error_info(4, "Неизвестная ошибка при вызове компилятора"),
         error_info(5, "Входной файл не открыт корректно"),
+        error_info(6, "Символ UTF-8 не представим в кодировке Windows-1251"),
+        error_info(7, "Слишком много входных файлов программы"),
         
         error_info(31, "Файл журнала записан некорректно"),
         
         error_info(76, "Отсутствует секция препроцессора"),
         error_info(77, "Нет такого файла для вставки"),
         error_info(78, "Неизвестная ошибка препроцессора"),
+        error_info(79, "Блок ##when не закрыт ##endwhen"),
+        error_info(80, "##otherwise или ##endwhen без ##when"),
+        error_info(81, "Некорректное условие ##when"),
         
         error_info(101, "Неизвестная ошибка лексического анализа"),
         error_info(102, "Недопустимый символ"),
@@ -105,19 +110,26 @@ namespace Error {
     };
     
     void initializeErrorList() {
+        // Список выше заполняется подряд, а не по индексам:
+        // записи переносятся на место своего кода
+        std::vector<error_info> listed;
         for (int i = 0; i <= 1000; i++) {
-            if (error_list[i].id == 0) {
-                error_list[i] = error_info(i, "Неизвестный код ошибки");
+            if (error_list[i].message[0] != '\0') {
+                listed.push_back(error_list[i]);
+            }
+            error_list[i] = error_info(i, "Неизвестный код ошибки");
+        }
+        for (const auto& err : listed) {
+            if (err.id <= 1000) {
+                error_list[err.id] = err;
             }
         }
     }
     
     error_info getErrorID(unsigned short id) {
-        static bool initialized = false;
-        if (!initialized) {
-            initializeErrorList();
-            initialized = true;
-        }
+        // Инициализация статической переменной потокобезопасна
+        static const bool initialized = (initializeErrorList(), true);
+        (void)initialized;
         
         if (id > 1000) {
             return error_list[999];
@@ -125,11 +137,25 @@ namespace Error {
         return error_list[id];
     }
     
+    static thread_local std::ostream* output = nullptr;
+
+    std::ostream& out() {
+        return output ? *output : Log::console();
+    }
+
+    OutputScope::OutputScope(std::ostream& stream) : saved(output) {
+        output = &stream;
+    }
+
+    OutputScope::~OutputScope() {
+        output = saved;
+    }
+
     void ThrowConsole(unsigned short id, bool critical) {
         error_info err = getErrorID(id);
-        std::cout << "\nОшибка " << err.id << ": " << err.message << "\n\n";
+        Error::out() << "\nОшибка " << err.id << ": " << err.message << "\n\n";
         if (err.line > 0) {
-            std::cout << "В строке: " << err.line << ", столбец: " << err.col << "\n";
+            Error::out() << "В строке: " << err.line << ", столбец: " << err.col << "\n";
         }
         if (critical) {
             throw err.id;
@@ -138,11 +164,11 @@ namespace Error {
     
     void ThrowConsole(unsigned short id, int line, int col, bool critical, const std::string& extra) {
         error_info err = getErrorID(id);
-        std::cout << "\nОшибка " << err.id << ": " << err.message;
+        Error::out() << "\nОшибка " << err.id << ": " << err.message;
         if (!extra.empty()) {
-            std::cout << " - " << extra;
+            Error::out() << " - " << extra;
         }
-        std::cout << "\nВ строке: " << line << ", столбец: " << col << "\n\n";
+        Error::out() << "\nВ строке: " << line << ", столбец: " << col << "\n\n";
         if (critical) {
             throw err.id;
         }
@@ -150,12 +176,12 @@ namespace Error {
     
     void ThrowConsole(unsigned short id, const lexan::Token& token, bool critical, const std::string& extra) {
         error_info err = getErrorID(id);
-        std::cout << "\nОшибка " << err.id << ": " << err.message;
+        Error::out() << "\nОшибка " << err.id << ": " << err.message;
         if (!extra.empty()) {
-            std::cout << " - " << extra;
+            Error::out() << " - " << extra;
         }
-        std::cout << "\nВ строке: " << token.line << ", столбец: " << token.column;
-        std::cout << " ('" << token.value << "')\n\n";
+        Error::out() << "\nВ строке: " << token.line << ", столбец: " << token.column;
+        Error::out() << " ('" << token.value << "')\n\n";
         if (critical) {
             throw err.id;
         }
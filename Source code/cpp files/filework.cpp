@@ -1,62 +1,302 @@
 #include <precomph.h>
+#include "artifacts.h"
+#include <cerrno>
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace FileWork {
-    string ReadFile(const string& filename) {
-        ifstream file(filename);
+#ifndef _WIN32
+    // Содержимое открытого fd в bytes: один read в буфер по размеру из
+    // fstat (size; с запасом в байт, чтобы увидеть конец файла и не
+    // перераспределять строку под перевод строки из ReadFile), для
+    // каналов - блоками. Закрывает fd
+    static bool readDescriptor(int fd, size_t size, string& bytes) {
+        bytes.resize(size + 1);
+        size_t total = 0;
+        for (;;) {
+            if (total == bytes.size()) {
+                bytes.resize(std::max<size_t>(bytes.size() * 2, 64 * 1024));
+            }
+            ssize_t n = ::read(fd, &bytes[total], bytes.size() - total);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ::close(fd);
+                bytes.clear();
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            total += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        bytes.resize(total);
+        return true;
+    }
+
+    // Размер обычного файла из fstat, 0 - для каналов и устройств
+    static size_t regularSize(int fd) {
+        struct stat st;
+        return fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0;
+    }
+
+    static bool readBytes(const string& filename, string& bytes) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        return readDescriptor(fd, regularSize(fd), bytes);
+    }
+
+    bool MappedFile::open(const string& filename) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        size_t size = regularSize(fd);
+        long page = sysconf(_SC_PAGESIZE);
+
+        // Хвост последней страницы отображения заполнен нулями - это и есть
+        // завершающий ноль; при размере, кратном странице, места под него нет
+        if (size > 0 && page > 0 && size % static_cast<size_t>(page) != 0) {
+            void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                ::close(fd);
+                data = static_cast<const char*>(address);
+                length = size;
+                mapped = size;
+                return true;
+            }
+        }
+
+        if (!readDescriptor(fd, size, buffer)) {
+            return false;
+        }
+        data = buffer.c_str();
+        length = buffer.size();
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (mapped > 0) {
+            munmap(const_cast<char*>(data), mapped);
+        }
+        data = "";
+        length = 0;
+        mapped = 0;
+        buffer.clear();
+    }
+#else
+    static bool readBytes(const string& filename, string& bytes) {
+        ifstream file(filename, ios::binary);
         if (!file.is_open()) {
-        Error::ThrowConsole(5);
-            return "";
+            return false;
+        }
+        bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool MappedFile::open(const string& filename) {
+        close();
+        if (!readBytes(filename, buffer)) {
+            return false;
         }
+        data = buffer.c_str();
+        length = buffer.size();
+        return true;
+    }
+
+    void MappedFile::close() {
+        data = "";
+        length = 0;
+        mapped = 0;
+        buffer.clear();
+    }
+#endif
 
-        string content;
-        string line;
-        while (getline(file, line)) {
-            content += line + '\n';
+    short ReadFile(const string& filename, string& content, bool from_utf8) {
+        content.clear();
+        // Без перекодировки файл читается сразу в content, без промежуточной
+        // копии; с from_utf8 декодер читает отображение файла и пишет в content
+        MappedFile file;
+        if (from_utf8 ? !file.open(filename) : !readBytes(filename, content)) {
+        Error::ThrowConsole(5);
+            return 5;
         }
 
-        file.close();
-        return content;
+        if (from_utf8) {
+            std::string_view view = file.view();
+            size_t bad_pos;
+            unsigned bad_code;
+            content.reserve(view.size() + 1);
+            if (decodeSource(view, content, bad_pos, bad_code) == SOURCE_UNMAPPABLE) {
+                // Столбец - в символах UTF-8, а не в байтах
+                size_t line_start = bad_pos == 0 ? std::string::npos : view.rfind('\n', bad_pos - 1);
+                line_start = line_start == std::string::npos ? 0 : line_start + 1;
+                if (line_start == 0 && view.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+                    line_start = 3;
+                }
+                int row = 1 + static_cast<int>(std::count(view.begin(), view.begin() + bad_pos, '\n'));
+                int col = 1;
+                for (size_t i = line_start; i < bad_pos; i++) {
+                    if ((static_cast<unsigned char>(view[i]) & 0xC0) != 0x80) {
+                        col++;
+                    }
+                }
+                char code[16];
+                std::snprintf(code, sizeof(code), "U+%04X", bad_code);
+                Error::ThrowConsole(6, row, col, false, string(code) + ", " + filename);
+                content.clear();
+                return 6;
+            }
+        }
+        if (!content.empty() && content.back() != '\n') {
+            content.push_back('\n');
+        }
+        return 0;
     }
 
     short WriteFile(const string output_file, string data) {
         string filename = output_file.empty() ? "default.log" : output_file;
 
-        ofstream logfile(filename, ios::out);
-        if (!logfile.is_open()) {
+        // Файл пишет фоновый поток (artifacts.h); ошибка отложенной записи
+        // выдается, когда компиляция ждет свои файлы
+        data.push_back('\n');
+        if (!artifacts::write(filename, std::move(data))) {
             Error::ThrowConsole(5);
             return -1;
         }
-
-        logfile << data << endl;
-        logfile.close();
         return 0;
     }
 
-        int FindRow(string text, size_t pos) {
-        int row = 1;
-        for (size_t i = 0; i < pos && i < text.size(); i++) {
-            if (text[i] == '\n') row++;
+        // Разовые запросы; для нескольких позиций одного буфера - LineIndex
+        int FindRow(const string& text, size_t pos) {
+        pos = std::min(pos, text.size());
+        return 1 + static_cast<int>(std::count(text.begin(), text.begin() + pos, '\n'));
         }
-        return row;
+
+        int FindCol(const string& text, size_t pos) {
+        pos = std::min(pos, text.size());
+        size_t line_start = (pos == 0) ? string::npos : text.rfind('\n', pos - 1);
+        return static_cast<int>(pos - (line_start == string::npos ? 0 : line_start + 1)) + 1;
         }
 
-        int FindCol(string text, size_t pos) {
-        int col = 1;
-        for (size_t i = pos; i > 0; i--) {
-            if (text[i - 1] == '\n') break;
-            col++;
+    void LineIndex::build(std::string_view text) {
+        starts.clear();
+        starts.push_back(0);
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        for (const char* p = begin; (p = static_cast<const char*>(memchr(p, '\n', end - p))) != nullptr; ) {
+            ++p;
+            starts.push_back(p - begin);
         }
+    }
+
+    void LineIndex::locate(size_t pos, int& row, int& col) const {
+        size_t line = std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+        row = static_cast<int>(line) + 1;
+        col = static_cast<int>(pos - starts[line]) + 1;
+    }
+
+    void LineIndex::locate(size_t pos, int& row, int& col, size_t& hint) const {
+        if (hint >= starts.size() || starts[hint] > pos) {
+            hint = std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin() - 1;
+        } else {
+            while (hint + 1 < starts.size() && starts[hint + 1] <= pos) {
+                hint++;
+            }
+        }
+        row = static_cast<int>(hint) + 1;
+        col = static_cast<int>(pos - starts[hint]) + 1;
+    }
+
+    int LineIndex::row(size_t pos) const {
+        int row, col;
+        locate(pos, row, col);
+        return row;
+    }
+
+    int LineIndex::col(size_t pos) const {
+        int row, col;
+        locate(pos, row, col);
         return col;
+    }
+    static thread_local SourceManager* current_manager = nullptr;
+
+    SourceManager::FileID SourceManager::load(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = ids.find(path);
+            if (it != ids.end()) {
+                return it->second;
+            }
+        }
+
+        // Чтение вне блокировки: потоки предзагрузки читают разные файлы
+        auto loaded = std::make_unique<std::string>();
+        if (ReadFile(path, *loaded, transcode) == 6) {
+            transcode_failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = ids.find(path);
+        if (it != ids.end()) {
+            return it->second;
         }
+        FileID id = static_cast<FileID>(texts.size());
+        texts.push_back(std::move(loaded));
+        ids[path] = id;
+        return id;
+    }
+
+    const std::string& SourceManager::text(FileID id) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return *texts.at(id);
+    }
+
+    bool SourceManager::transcodeFailed() const {
+        return transcode_failed;
+    }
+
+    SourceManager* SourceManager::current() {
+        return current_manager;
+    }
+
+    SourceManager::Scope::Scope(SourceManager* manager) : saved(current_manager) {
+        current_manager = manager;
+    }
+
+    SourceManager::Scope::~Scope() {
+        current_manager = saved;
+    }
+
+    const std::string& SourceText(const std::string& path, std::string& storage) {
+        if (SourceManager* manager = SourceManager::current()) {
+            return manager->text(manager->load(path));
+        }
+        ReadFile(path, storage);
+        return storage;
+    }
+
         bool fileExists(const std::string& filename) {
         return fs::exists(filename);
         }
 
         std::string getCurrentDateTime() {
             std::time_t now = std::time(nullptr);
-            std::tm* tm_now = std::localtime(&now);
+            std::tm tm_now;
+            localtime_r(&now, &tm_now);
             char buffer[80];
-            std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", tm_now);
+            std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_now);
             return std::string(buffer);
         }
 }
\ No newline at end of file
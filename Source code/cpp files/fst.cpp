@@ -5,11 +5,14 @@
 #include <functional>
 #include <algorithm>
 #include <set>
+#include <mutex>
 
 namespace fst {
 
+// Правила строятся один раз и затем только читаются всеми парсерами
 static std::vector<FSTRule> rules;
 static short nodeCounter = 0;
+static std::mutex rulesMutex;
 
 // Вспомогательные функции
 FSTnode* createNode(lexan::TokenType content, const std::string& value = "", bool optional = false) {
@@ -49,35 +52,35 @@ void printChain(FSTnode* node, int depth) {
     if (!node) return;
     
     for (int i = 0; i < depth; i++) {
-        std::cout << "  ";
+        Error::out() << "  ";
     }
     
-    std::cout << "[" << node->id << "] ";
-    std::cout << lexan::Lexer::token_type_to_string(node->content);
+    Error::out() << "[" << node->id << "] ";
+    Error::out() << lexan::Lexer::token_type_to_string(node->content);
     
     if (!node->value.empty()) {
-        std::cout << " (\"" << node->value << "\")";
+        Error::out() << " (\"" << node->value << "\")";
     }
     
     if (node->is_optional) {
-        std::cout << " [OPTIONAL]";
+        Error::out() << " [OPTIONAL]";
     }
     
-    std::cout << std::endl;
+    Error::out() << std::endl;
     
     if (node->next) {
         for (int i = 0; i < depth; i++) {
-            std::cout << "  ";
+            Error::out() << "  ";
         }
-        std::cout << "  -> next:" << std::endl;
+        Error::out() << "  -> next:" << std::endl;
         printChain(node->next, depth + 1);
     }
     
     if (node->alternative) {
         for (int i = 0; i < depth; i++) {
-            std::cout << "  ";
+            Error::out() << "  ";
         }
-        std::cout << "  -> alternative:" << std::endl;
+        Error::out() << "  -> alternative:" << std::endl;
         printChain(node->alternative, depth + 1);
     }
 }
@@ -560,18 +563,24 @@ bool isTypeSpecifier(lexan::TokenType type) {
            type == lexan::TK_SYMB;
 }
 
-void initChains() {
-    std::cout << "[FST] Initializing rules..." << std::endl;
-    
-    // Очищаем существующие правила
+static void clearRules() {
     for (auto& rule : rules) {
         deleteChain(rule.start);
     }
     rules.clear();
     nodeCounter = 0;
+}
+
+void initChains() {
+    std::lock_guard<std::mutex> lock(rulesMutex);
+    if (!rules.empty()) {
+        return;
+    }
+    
+    Log::debug() << "[FST] Initializing rules..." << "\n";
     
     try {
-        std::cout << "[FST] Creating rules..." << std::endl;
+        Log::debug() << "[FST] Creating rules..." << "\n";
         
         // Основные правила
         rules.push_back(FSTRule("variable_declaration", createVariableDeclChain(), 3, 10));
@@ -618,23 +627,23 @@ void initChains() {
             lexan::TK_SEMICOLON
         }), 4, 4));
         
-        std::cout << "[FST] Created " << rules.size() << " rules" << std::endl;
-        std::cout << "[FST] Created " << nodeCounter << " nodes" << std::endl;
+        Log::debug() << "[FST] Created " << rules.size() << " rules\n";
+        Log::debug() << "[FST] Created " << nodeCounter << " nodes\n";
         
     } catch (const std::exception& e) {
         std::cerr << "[FST] Error during initialization: " << e.what() << std::endl;
-        cleanup();
+        clearRules();
         throw;
     }
 }
 
 void printAllRules() {
-    std::cout << "\n[FST] Rules:" << std::endl;
+    Error::out() << "\n[FST] Rules:" << std::endl;
     for (size_t i = 0; i < rules.size(); i++) {
-        std::cout << "\nRule " << i << ": " << rules[i].name 
-                  << " (min: " << rules[i].min_length 
-                  << ", max: " << (rules[i].max_length == -1 ? "unlimited" : std::to_string(rules[i].max_length)) 
-                  << ")" << std::endl;
+        Error::out() << "\nRule " << i << ": " << rules[i].name 
+                     << " (min: " << rules[i].min_length 
+                     << ", max: " << (rules[i].max_length == -1 ? "unlimited" : std::to_string(rules[i].max_length)) 
+                     << ")" << std::endl;
         printChain(rules[i].start, 1);
     }
 }
@@ -653,15 +662,12 @@ FSTRule* getRuleByName(const std::string& name) {
 }
 
 void cleanup() {
-    std::cout << "[FST] Cleaning up..." << std::endl;
+    std::lock_guard<std::mutex> lock(rulesMutex);
+    Log::debug() << "[FST] Cleaning up..." << "\n";
     
-    for (auto& rule : rules) {
-        deleteChain(rule.start);
-    }
-    rules.clear();
-    nodeCounter = 0;
+    clearRules();
     
-    std::cout << "[FST] Cleanup completed" << std::endl;
+    Log::debug() << "[FST] Cleanup completed" << "\n";
 }
 
 FSTnode* createComplexFunctionDeclChain() {
@@ -0,0 +1,199 @@
+#include <precomph.h>
+#include "includes.h"
+#include "cache.h"
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <set>
+
+namespace includes {
+
+struct CacheEntry {
+    fs::file_time_type mtime;
+    uintmax_t size;
+    uint64_t hash;
+    std::shared_ptr<const Library> library;
+};
+
+static std::mutex cache_mutex;
+static std::map<std::string, CacheEntry> cache_entries;
+
+static uint64_t hashContent(const std::string& data) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Секция функций (сначала singular, затем plural маркеры) и строки ##perceive
+static std::shared_ptr<const Library> parse(const std::string& key, const std::string& code) {
+    auto library = std::make_shared<Library>();
+    library->key = key;
+
+    std::string func_begin_marker = "[function section begin]";
+    std::string func_end_marker = "[function section end]";
+    size_t func_begin = code.find(func_begin_marker);
+    size_t func_end = code.find(func_end_marker);
+
+    if (func_begin == std::string::npos || func_end == std::string::npos) {
+        func_begin_marker = "[functions section begin]";
+        func_end_marker = "[functions section end]";
+        func_begin = code.find(func_begin_marker);
+        func_end = code.find(func_end_marker);
+    }
+
+    if (func_begin != std::string::npos && func_end != std::string::npos && func_end > func_begin) {
+        library->has_functions = true;
+        size_t from = func_begin + func_begin_marker.length();
+        size_t func_start = code.find_first_not_of(" \t\n\r", from);
+        if (func_start != std::string::npos && func_start < func_end) {
+            size_t func_end_pos = code.find_last_not_of(" \t\n\r", func_end - 1);
+            library->functions = code.substr(func_start, func_end_pos - func_start + 1);
+            FileWork::LineIndex(code).locate(func_start, library->functions_line,
+                                             library->functions_column);
+        }
+    }
+
+    size_t macro_pos = 0;
+    while ((macro_pos = code.find("##perceive", macro_pos)) != std::string::npos) {
+        size_t line_end = code.find('\n', macro_pos);
+        if (line_end == std::string::npos) line_end = code.size();
+        library->macro_lines.push_back(code.substr(macro_pos, line_end - macro_pos));
+        macro_pos = line_end;
+    }
+    return library;
+}
+
+std::string canonicalName(const std::string& name, bool from_resolver) {
+    if (from_resolver) {
+        return name;
+    }
+    std::error_code ec;
+    fs::path path = fs::weakly_canonical(fs::path(name), ec);
+    return ec ? fs::path(name).lexically_normal().string() : path.string();
+}
+
+// Запись cache_key (файл name) с содержимым code; hash уже посчитан.
+// Разбор - вне блокировки: потоки предзагрузки разбирают файлы параллельно
+static std::shared_ptr<const Library> remember(const std::string& cache_key, const std::string& name,
+                                               const std::string& code, uint64_t hash,
+                                               fs::file_time_type mtime, uintmax_t size,
+                                               bool* cached) {
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache_entries.find(cache_key);
+        if (it != cache_entries.end() && it->second.hash == hash) {
+            it->second.mtime = mtime;
+            it->second.size = size;
+            if (cached) *cached = true;
+            return it->second.library;
+        }
+    }
+
+    std::shared_ptr<const Library> library = parse(name, code);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    CacheEntry& entry = cache_entries[cache_key];
+    // Тот же файл мог быть разобран другим потоком, пока шел разбор
+    if (entry.library && entry.hash == hash) {
+        return entry.library;
+    }
+    entry.mtime = mtime;
+    entry.size = size;
+    entry.hash = hash;
+    entry.library = library;
+    return library;
+}
+
+std::shared_ptr<const Library> load(const std::string& name, const IncludeResolver& resolver,
+                                    bool* cached) {
+    if (cached) *cached = false;
+
+    if (resolver) {
+        std::string code;
+        if (!resolver(name, code)) {
+            Error::ThrowConsole(5);
+            return nullptr;
+        }
+        if (code.empty()) {
+            return nullptr;
+        }
+        return remember("resolver:" + name, name, code, hashContent(code), fs::file_time_type(),
+                        code.size(), cached);
+    }
+
+    // Текст файла с диска зависит от перекодировки (-utf8): разборы двух
+    // режимов хранятся отдельно
+    std::string key = canonicalName(name, false);
+    FileWork::SourceManager* sources = FileWork::SourceManager::current();
+    std::string cache_key = (sources && sources->transcoding()) ? "utf8:" + key : key;
+    std::error_code ec;
+    fs::file_time_type mtime = fs::last_write_time(name, ec);
+    uintmax_t size = ec ? 0 : fs::file_size(name, ec);
+    if (!ec) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache_entries.find(cache_key);
+        if (it != cache_entries.end() && it->second.mtime == mtime && it->second.size == size) {
+            if (cached) *cached = true;
+            return it->second.library;
+        }
+    }
+
+    // Файл новый или изменился по времени/размеру: чтение (через менеджер
+    // файлов компиляции, если он есть) и сравнение хеша
+    std::string storage;
+    const std::string& code = FileWork::SourceText(name, storage);
+    if (code.empty()) {
+        return nullptr;
+    }
+    return remember(cache_key, key, code, hashContent(code), mtime, size, cached);
+}
+
+// Одновременно читаемых файлов не больше этого числа
+static const size_t PREFETCH_THREADS = 8;
+
+void prefetch(const std::vector<std::string>& names) {
+    FileWork::SourceManager* sources = FileWork::SourceManager::current();
+    std::set<std::string> seen;
+    std::vector<std::string> wave;
+    for (const auto& name : names) {
+        if (seen.insert(canonicalName(name, false)).second) {
+            wave.push_back(name);
+        }
+    }
+
+    // Волнами: файлы вложенных ##inaddition известны только после чтения
+    while (!wave.empty()) {
+        std::vector<std::string> next;
+        for (size_t first = 0; first < wave.size(); first += PREFETCH_THREADS) {
+            size_t last = std::min(wave.size(), first + PREFETCH_THREADS);
+            std::vector<std::future<std::shared_ptr<const Library>>> loads;
+            for (size_t i = first; i < last; i++) {
+                const std::string& name = wave[i];
+                loads.push_back(std::async(std::launch::async, [name, sources]() {
+                    TRACE_SCOPE("prefetch include");
+                    FileWork::SourceManager::Scope scope(sources);
+                    std::error_code ec;
+                    if (!fs::is_regular_file(name, ec)) {
+                        return std::shared_ptr<const Library>();
+                    }
+                    return load(name, IncludeResolver());
+                }));
+            }
+            for (auto& pending : loads) {
+                std::shared_ptr<const Library> library = pending.get();
+                if (!library) continue;
+                for (const auto& nested : cache::scanIncludeNames(library->functions)) {
+                    if (seen.insert(canonicalName(nested, false)).second) {
+                        next.push_back(nested);
+                    }
+                }
+            }
+        }
+        wave.swap(next);
+    }
+}
+
+} // namespace includes
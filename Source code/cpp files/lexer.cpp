@@ -1,50 +1,96 @@
 #include <precomph.h>
+#include "artifacts.h"
 
 namespace lexan {
-	static std::map<std::string, TokenType> init_keywords() {
-		std::map<std::string, TokenType> keywords;
-		
-		keywords["procedure"] = TK_PROCEDURE;
-		keywords["algo"] = TK_ALGO;
-		keywords["bool"] = TK_BOOL;
-		keywords["unsigned"] = TK_UNSIGNED;
-		keywords["int"] = TK_INT;
-		keywords["string"] = TK_STRING;
-		keywords["time_t"] = TK_TIME_T;
-		keywords["ces"] = TK_CES;
-		keywords["est"] = TK_EST;
-		keywords["do"] = TK_DO;
-		keywords["while"] = TK_WHILE;
-		keywords["return"] = TK_RETURN;
-		keywords["symb"] = TK_SYMB;
-		keywords["if"] = TK_IF;
-		keywords["else"] = TK_ELSE;
-		
-		keywords["true"] = TK_TRUE;
-		keywords["false"] = TK_FALSE;
-		
-		return keywords;
+	// Ключевые слова и встроенные функции
+	struct Word {
+		std::string_view text;
+		TokenType type;
+		bool builtin;
+	};
+
+	static constexpr Word words[] = {
+		{"procedure", TK_PROCEDURE, false},
+		{"algo", TK_ALGO, false},
+		{"bool", TK_BOOL, false},
+		{"unsigned", TK_UNSIGNED, false},
+		{"int", TK_INT, false},
+		{"string", TK_STRING, false},
+		{"time_t", TK_TIME_T, false},
+		{"ces", TK_CES, false},
+		{"est", TK_EST, false},
+		{"do", TK_DO, false},
+		{"while", TK_WHILE, false},
+		{"return", TK_RETURN, false},
+		{"symb", TK_SYMB, false},
+		{"if", TK_IF, false},
+		{"else", TK_ELSE, false},
+
+		{"true", TK_TRUE, false},
+		{"false", TK_FALSE, false},
+
+		{"proclaim", TK_BUILTIN_PROCLAIM, true},
+		{"to_str", TK_BUILTIN_TO_STR, true},
+		{"TimeFled", TK_BUILTIN_TIME_FLED, true},
+		{"ThisVeryMoment", TK_BUILTIN_THIS_VERY_MOMENT, true},
+		{"unite", TK_BUILTIN_UNITE, true},
+		{"sum4", TK_BUILTIN_SUM4, true},
+	};
+
+	static const size_t WORD_COUNT = sizeof(words) / sizeof(words[0]);
+	static const size_t WORD_SLOTS = 64;
+	// Подобран так, чтобы у всех слов были разные ячейки
+	static const size_t WORD_LENGTH_FACTOR = 34;
+
+	// Совершенный хеш по первому и последнему символу и длине (непустого слова)
+	static constexpr size_t word_slot(std::string_view word) {
+		return (static_cast<unsigned char>(word.front()) + static_cast<unsigned char>(word.back()) +
+		        WORD_LENGTH_FACTOR * word.size()) & (WORD_SLOTS - 1);
 	}
 
-	static std::map<std::string, TokenType> init_builtins() {
-		std::map<std::string, TokenType> builtins;
-		
-		builtins["proclaim"] = TK_BUILTIN_PROCLAIM;
-		builtins["to_str"] = TK_BUILTIN_TO_STR;
-		builtins["TimeFled"] = TK_BUILTIN_TIME_FLED;
-		builtins["ThisVeryMoment"] = TK_BUILTIN_THIS_VERY_MOMENT;
-		builtins["unite"] = TK_BUILTIN_UNITE;
-		builtins["sum4"] = TK_BUILTIN_SUM4;
-		
-		return builtins;
+	// Номер слова в words для каждой ячейки хеша, -1 - ячейка пуста.
+	// Строится при компиляции; perfect - нет двух слов в одной ячейке
+	struct WordTable {
+		signed char index[WORD_SLOTS];
+		bool perfect;
+	};
+
+	static constexpr WordTable build_word_table() {
+		WordTable table{};
+		for (size_t slot = 0; slot < WORD_SLOTS; slot++) {
+			table.index[slot] = -1;
+		}
+		table.perfect = true;
+		for (size_t i = 0; i < WORD_COUNT; i++) {
+			size_t slot = word_slot(words[i].text);
+			if (table.index[slot] >= 0) {
+				table.perfect = false;
+			}
+			table.index[slot] = static_cast<signed char>(i);
+		}
+		return table;
+	}
+
+	static constexpr WordTable word_table = build_word_table();
+	static_assert(word_table.perfect, "keyword hash collision: change WORD_LENGTH_FACTOR");
+
+	// Слово из words или nullptr: одна ячейка и одно сравнение, без выделения памяти
+	static const Word* find_word(std::string_view word) {
+		if (word.empty()) {
+			return nullptr;
+		}
+		int index = word_table.index[word_slot(word)];
+		if (index < 0 || words[index].text != word) {
+			return nullptr;
+		}
+		return &words[index];
 	}
 
 	Lexer::Lexer(const std::string& source_code, const std::string& fname)
-		: source(source_code), filename(fname), position(0), 
-		line(1), column(1), current_char(0) {
-		
-		keywords = init_keywords();
-		builtins = init_builtins();
+		: source(source_code), filename(fname), position(0),
+		lines(source), line_hint(0), line(1), column(1), current_char(0),
+		limit(source.length()),
+		markup(false) {
 		
 		if (!source.empty()) {
 			current_char = source[0];
@@ -52,24 +98,21 @@ namespace lexan {
 	}
 
 	void Lexer::advance() {
-		if (current_char == '\n') {
-			line++;
-			column = 1;
-		} else if (current_char != '\0') {
-			column++;
-		}
-		
 		position++;
-		if (position < source.length()) {
+		if (position < limit) {
 			current_char = source[position];
 		} else {
 			current_char = '\0';
 		}
 	}
 
+	void Lexer::update_position() {
+		lines.locate(position, line, column, line_hint);
+	}
+
 	char Lexer::peek(int offset) const {
 		size_t peek_pos = position + offset;
-		if (peek_pos < source.length()) {
+		if (peek_pos < limit) {
 			return source[peek_pos];
 		}
 		return '\0';
@@ -107,6 +150,26 @@ namespace lexan {
 		}
 	}
 
+	// Разметка, которую при обычном порядке этапов удаляет препроцессор
+	// (clean_up в preprocess.cpp); true - текущий символ пропущен
+	bool Lexer::skip_markup() {
+		size_t next;
+		if (current_char == '[') {
+			size_t length = SectionMarkerLength(source, position);
+			next = position + (length > 0 ? length : 1);
+		} else if (current_char == ']') {
+			next = position + 1;
+		} else if (current_char == '@') {
+			size_t close = source.find('@', position + 1);
+			next = (close != std::string::npos && close < limit) ? close + 1 : position + 1;
+		} else {
+			return false;
+		}
+		position = std::min(next, limit) - 1;
+		advance();
+		return true;
+	}
+
 	bool Lexer::is_alpha(char c) const {
 		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 	}
@@ -218,12 +281,12 @@ namespace lexan {
 				token.numeric_data.int_value = std::stol(number_str);
 			}
 		} catch (const std::out_of_range&) {
-			std::cout << "\nВ строке " << start_line << ", столбец " << start_column 
+			Error::out() << "\nВ строке " << start_line << ", столбец " << start_column 
 					  << ": Числовое значение вне диапазона: " << number_str << "\n\n";
 			token.type = TK_ERROR;
 			token.value = "";
 		} catch (const std::invalid_argument&) {
-			std::cout << "\nВ строке " << start_line << ", столбец " << start_column 
+			Error::out() << "\nВ строке " << start_line << ", столбец " << start_column 
 					  << ": Некорректный числовой формат: " << number_str << "\n\n";
 			token.type = TK_ERROR;
 			token.value = "";
@@ -237,24 +300,14 @@ namespace lexan {
 		int start_column = column;
 		size_t start_pos = position;
 		
-		std::string identifier;
-		
 		while (is_alpha_numeric(current_char)) {
-			identifier += current_char;
 			advance();
 		}
 		
-		auto keyword_it = keywords.find(identifier);
-		if (keyword_it != keywords.end()) {
-			return Token(keyword_it->second, identifier, start_line, start_column, start_pos);
-		}
-		
-		auto builtin_it = builtins.find(identifier);
-		if (builtin_it != builtins.end()) {
-			return Token(builtin_it->second, identifier, start_line, start_column, start_pos);
-		}
-		
-		return Token(TK_IDENTIFIER, identifier, start_line, start_column, start_pos);
+		std::string_view identifier = source.substr(start_pos, position - start_pos);
+		const Word* word = find_word(identifier);
+		return Token(word ? word->type : TK_IDENTIFIER, std::string(identifier),
+		             start_line, start_column, start_pos);
 	}
 
 	Token Lexer::read_string() {
@@ -279,7 +332,8 @@ namespace lexan {
 					case '\"': str_value += '\"'; break;
 					case '\'': str_value += '\''; break;
 					default:
-						std::cout << "\nВ строке " << line << ", столбец " << column 
+						update_position();
+						Error::out() << "\nВ строке " << line << ", столбец " << column 
 								  << ": Неизвестный escape-символ: \\" << current_char << "\n\n";
 						str_value += current_char;
 						break;
@@ -308,10 +362,10 @@ namespace lexan {
 		}
 		
 		if (quote_char == '"') {
-			std::cout << "\nВ строке " << start_line << ", столбец " << start_column 
+			Error::out() << "\nВ строке " << start_line << ", столбец " << start_column 
 					  << ": Незакрытая строковая константа\n\n";
 		} else {
-			std::cout << "\nВ строке " << start_line << ", столбец " << start_column 
+			Error::out() << "\nВ строке " << start_line << ", столбец " << start_column 
 					  << ": Незакрытая символьная константа\n\n";
 		}
 		
@@ -445,7 +499,7 @@ namespace lexan {
 				
 			default:
 				std::string unknown(1, first_char);
-				std::cout << "\nВ строке " << start_line << ", столбец " << start_column 
+				Error::out() << "\nВ строке " << start_line << ", столбец " << start_column 
 						  << ": Неизвестный оператор: " << unknown << "\n\n";
 				return Token(TK_ERROR, "", start_line, start_column, start_pos);
 		}
@@ -464,9 +518,14 @@ namespace lexan {
 				continue;
 			}
 			
+			if (markup && skip_markup()) {
+				continue;
+			}
+			
 			break;
 		}
 		
+		update_position();
 		if (current_char == '\0') {
 			return Token(TK_EOF, "", line, column, position);
 		}
@@ -487,6 +546,7 @@ namespace lexan {
 	}
 
 	std::vector<Token> Lexer::tokenize() {
+		stats::ScopedTimer timer(stats::STAGE_LEXER);
 		std::vector<Token> tokens;
 		reset();
 		
@@ -499,12 +559,21 @@ namespace lexan {
 			token = get_next_token();
 		}
 		tokens.push_back(token);
+		stats::count(stats::COUNTER_TOKENS, tokens.size());
 		
 		return tokens;
 	}
 
+	void Lexer::set_range(size_t begin, size_t end) {
+		limit = std::min(end, source.length());
+		position = begin;
+		current_char = position < limit ? source[position] : '\0';
+	}
+
 	void Lexer::reset() {
 		position = 0;
+		limit = source.length();
+		line_hint = 0;
 		line = 1;
 		column = 1;
 		if (!source.empty()) {
@@ -593,26 +662,18 @@ namespace lexan {
 	}
 
 	bool Lexer::is_keyword(const std::string& word) {
-		static auto keywords = init_keywords();
-		return keywords.find(word) != keywords.end();
+		const Word* found = find_word(word);
+		return found && !found->builtin;
 	}
 
 	bool Lexer::is_builtin(const std::string& word) {
-		static auto builtins = init_builtins();
-		return builtins.find(word) != builtins.end();
+		const Word* found = find_word(word);
+		return found && found->builtin;
 	}
 
-	bool Lexer::generate_token_file(const std::string& source_code, const std::string& output_filename) {
+	bool Lexer::generate_token_file(const std::vector<Token>& tokens, const std::string& output_filename) {
 		try {
-			Lexer lexer(source_code, output_filename);
-			std::vector<Token> tokens = lexer.tokenize();
-			
-			std::ofstream out_file(output_filename);
-			if (!out_file.is_open()) {
-				Error::ThrowConsole(31, true);
-				return false;
-			}
-			
+			std::ostringstream out_file;
 			out_file << "=== Анализ токенов ===\n";
 			out_file << "Источник: " << (output_filename.empty() ? "ввод" : output_filename) << "\n";
 			out_file << "Всего токенов: " << tokens.size() << "\n";
@@ -738,7 +799,10 @@ namespace lexan {
 						<< ": " << count << "\n";
 			}
 			
-			out_file.close();
+			if (!artifacts::write(output_filename, out_file.str())) {
+				Error::ThrowConsole(31, true);
+				return false;
+			}
 			return true;
 			
 		} catch (const std::exception& e) {
@@ -749,7 +813,7 @@ namespace lexan {
 	
 	bool performLexicalAnalysis(const std::string& source_code, const std::string& filename,
                            std::vector<lexan::Token>& tokens) {
-		std::cout << "Лексический анализ...\n";
+		Log::info() << "Лексический анализ...\n";
 		lexan::Lexer lexer(source_code, filename);
 		tokens = lexer.tokenize();
 		
@@ -764,7 +828,7 @@ namespace lexan {
 			}
 		}
 		
-		std::cout << "Сгенерировано токенов: " << tokens.size() << std::endl;
+		Log::info() << "Сгенерировано токенов: " << tokens.size() << "\n";
 		return true;
 	}
 }
\ No newline at end of file
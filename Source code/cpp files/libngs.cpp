@@ -0,0 +1,160 @@
+#include <precomph.h>
+#include "libngs.h"
+#include "semantic.h"
+#include "rpnconverter.h"
+#include "codegen.h"
+#include <chrono>
+
+namespace ngs {
+
+// Накопление диагностики с построчной передачей в DiagnosticSink
+class SinkBuffer : public std::streambuf {
+private:
+    const DiagnosticSink& sink;
+    std::string text;
+    size_t forwarded;
+
+    void forwardLines() {
+        if (!sink) return;
+        size_t end;
+        while ((end = text.find('\n', forwarded)) != std::string::npos) {
+            sink(text.substr(forwarded, end - forwarded + 1));
+            forwarded = end + 1;
+        }
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) {
+            text.push_back(static_cast<char>(c));
+            if (c == '\n') forwardLines();
+        }
+        return c;
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        text.append(s, n);
+        forwardLines();
+        return n;
+    }
+
+public:
+    explicit SinkBuffer(const DiagnosticSink& s) : sink(s), forwarded(0) {}
+
+    std::string finish() {
+        forwardLines();
+        if (sink && forwarded < text.size()) {
+            sink(text.substr(forwarded));
+            forwarded = text.size();
+        }
+        return text;
+    }
+};
+
+static bool runPipeline(const std::string& source, const IncludeResolver& includes,
+                        const CompileOptions& options, CompileResult& result) {
+    std::string log_content;
+    if (!checkWindows1251(source, log_content)) {
+        Error::ThrowConsole(998);
+        return false;
+    }
+
+    std::string program_name;
+    std::string preprocessed_code;
+    if (PreprocessSource(options.main_file, source, program_name, preprocessed_code,
+                         log_content, includes, options.defines) != 0) {
+        return false;
+    }
+    if (options.output == OUTPUT_PREPROCESSED) {
+        result.output = std::move(preprocessed_code);
+        return true;
+    }
+
+    lexan::Lexer lexer(preprocessed_code, program_name);
+    std::vector<lexan::Token> tokens = lexer.tokenize();
+    if (options.output == OUTPUT_TOKENS) {
+        std::stringstream out;
+        for (const auto& token : tokens) {
+            out << token.line << ":" << token.column << " "
+                << lexan::Lexer::token_type_to_string(token.type)
+                << " \"" << token.value << "\"\n";
+        }
+        result.output = out.str();
+    }
+    if (tokens.empty() || tokens.back().type == lexan::TK_ERROR) {
+        return false;
+    }
+    if (options.output == OUTPUT_TOKENS) {
+        return true;
+    }
+
+    parser::Parser parser(std::move(tokens));
+    if (!parser.parse()) {
+        return false;
+    }
+    if (options.output == OUTPUT_AST) {
+        std::stringstream out;
+        parser.print_ast(nullptr, 0, out);
+        result.output = out.str();
+        return true;
+    }
+    if (options.output == OUTPUT_RPN) {
+        rpn::RPNConverter converter;
+        result.output = converter.convert_program(parser.get_ast());
+        return true;
+    }
+    if (options.output == OUTPUT_SEMANTIC_REPORT) {
+        semantic::SemanticAnalyzer analyzer;
+        result.semantic_ok = analyzer.analyze(parser.get_ast());
+        result.output = analyzer.generate_report();
+        return true;
+    }
+
+    codegen::CodeGenerator generator;
+    if (options.semantic_check) {
+        semantic::SemanticAnalyzer analyzer;
+        result.semantic_ok = analyzer.analyze(parser.get_ast());
+        result.js = generator.generate(parser.get_ast(), &analyzer);
+    } else {
+        result.semantic_ok = true;
+        result.js = generator.generate(parser.get_ast());
+    }
+    return true;
+}
+
+CompileResult compile(const std::string& source, const IncludeResolver& includes,
+                      const CompileOptions& options) {
+    CompileResult result;
+    SinkBuffer buffer(options.diagnostics);
+    std::ostream diagnostics(&buffer);
+
+    // Без resolver ##inaddition не должен читать файлы с диска
+    IncludeResolver resolver = includes;
+    if (!resolver && !options.includes_from_disk) {
+        resolver = [](const std::string&, std::string&) { return false; };
+    }
+
+    stats::Collector* saved_stats = stats::active;
+    if (options.collect_stats) {
+        stats::active = &result.stats;
+    }
+    auto start = std::chrono::steady_clock::now();
+    {
+        Error::OutputScope capture(diagnostics);
+        try {
+            result.success = runPipeline(source, resolver, options, result);
+        }
+        catch (...) {
+            // Критические ошибки этапов (Error::ThrowConsole) уже выведены
+            result.success = false;
+        }
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    result.stats.total_wall_ms = elapsed.count();
+    stats::active = saved_stats;
+
+    result.diagnostics = buffer.finish();
+    return result;
+}
+
+} // namespace ngs
@@ -0,0 +1,78 @@
+#include <precomph.h>
+#include <cstdio>
+
+namespace Log {
+
+static thread_local Level current = LEVEL_INFO;
+
+Level level() {
+    return current;
+}
+
+LevelScope::LevelScope(Level l) : saved(current) {
+    current = l;
+}
+
+LevelScope::~LevelScope() {
+    current = saved;
+}
+
+// Буфер консоли: запись в stdout при заполнении и по flush.
+// fwrite в stdout идет через тот же FILE, что и std::cout
+// (синхронизирован с stdio), поэтому порядок вывода сохраняется
+class ConsoleBuffer : public std::streambuf {
+private:
+    static const size_t SIZE = 64 * 1024;
+    char data[SIZE];
+
+    void drain() {
+        if (pptr() > pbase()) {
+            std::fwrite(pbase(), 1, pptr() - pbase(), stdout);
+        }
+        setp(data, data + SIZE);
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        drain();
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        drain();
+        std::fflush(stdout);
+        return 0;
+    }
+
+public:
+    ConsoleBuffer() { setp(data, data + SIZE); }
+    ~ConsoleBuffer() { sync(); }
+};
+
+// Буфер объявлен раньше потока и разрушается после него
+static thread_local ConsoleBuffer console_buffer;
+static thread_local std::ostream console_stream(&console_buffer);
+// Без буфера поток сразу получает badbit, и operator<< ничего не делает
+static thread_local std::ostream null_stream(nullptr);
+
+std::ostream& console() {
+    return console_stream;
+}
+
+void flush() {
+    console_stream.flush();
+}
+
+std::ostream& info() {
+    return current >= LEVEL_INFO ? Error::out() : null_stream;
+}
+
+std::ostream& debug() {
+    return current >= LEVEL_DEBUG ? Error::out() : null_stream;
+}
+
+} // namespace Log
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "stats.h"
+#include "artifacts.h"
 #include <stack>
 #include <queue>
 #include <sstream>
@@ -6,30 +8,85 @@
 namespace parser {
 
 Parser::Parser(const std::vector<lexan::Token>& token_list)
-    : tokens(token_list), current_pos(0), root(nullptr) {
+    : tokens(token_list.begin(), token_list.end()), base_pos(0), current_pos(0),
+      root(nullptr), producer(nullptr), stream_done(true) {
+    // Правила FST общие для всех парсеров, строятся при первом вызове
     fst::initChains();
 }
 
+Parser::Parser(std::vector<lexan::Token>&& token_list)
+    : tokens(std::make_move_iterator(token_list.begin()), std::make_move_iterator(token_list.end())),
+      base_pos(0), current_pos(0), root(nullptr), producer(nullptr), stream_done(true) {
+    token_list.clear();
+    fst::initChains();
+}
+
+Parser::Parser(const std::string& source_code, const std::string& filename)
+    : base_pos(0), current_pos(0), root(nullptr), producer(nullptr), stream_done(false) {
+    fst::initChains();
+    producer = new lexan::PipelinedLexer(source_code, filename);
+}
+
 Parser::~Parser() {
+    delete producer;
     delete root;
-    fst::cleanup();
+}
+
+bool Parser::pull_batch() const {
+    if (stream_done) return false;
+
+    std::vector<lexan::Token> batch;
+    if (!producer->tokens().pop(batch)) {
+        stream_done = true;
+        return false;
+    }
+    stats::count(stats::COUNTER_TOKENS, batch.size());
+    // Последний токен потока: лексер закончил, его сообщения выводятся
+    // до того, как парсер дойдет до этих токенов (как без конвейера)
+    if (!batch.empty() && (batch.back().type == lexan::TK_EOF ||
+                           batch.back().type == lexan::TK_ERROR)) {
+        producer->finish();
+    }
+    for (auto& token : batch) {
+        tokens.push_back(std::move(token));
+    }
+    return true;
+}
+
+const lexan::Token* Parser::token_at(size_t pos) const {
+    while (pos - base_pos >= tokens.size()) {
+        if (!pull_batch()) return nullptr;
+    }
+    return &tokens[pos - base_pos];
+}
+
+// Токены уже разобранных объявлений больше не нужны ни для возврата,
+// ни для контекста FST
+void Parser::discard_consumed() {
+    if (!producer) return;
+    tokens.erase(tokens.begin(), tokens.begin() + (current_pos - base_pos));
+    base_pos = current_pos;
+}
+
+std::vector<lexan::Token> Parser::context_from(size_t start_pos) const {
+    return std::vector<lexan::Token>(tokens.begin() + (start_pos - base_pos),
+                                     tokens.begin() + (current_pos - base_pos));
 }
 
 const lexan::Token& Parser::current_token() const {
     static lexan::Token eof_token(lexan::TK_EOF, "", 0, 0, 0);
-    if (current_pos >= tokens.size()) return eof_token;
-    return tokens[current_pos];
+    const lexan::Token* token = token_at(current_pos);
+    return token ? *token : eof_token;
 }
 
 const lexan::Token& Parser::peek_token(int offset) const {
     static lexan::Token eof_token(lexan::TK_EOF, "", 0, 0, 0);
-    size_t peek_pos = current_pos + offset;
-    if (peek_pos >= tokens.size()) return eof_token;
-    return tokens[peek_pos];
+    const lexan::Token* token = token_at(current_pos + offset);
+    return token ? *token : eof_token;
 }
 
 void Parser::advance() {
-    if (current_pos < tokens.size()) {
+    if (token_at(current_pos)) {
         current_pos++;
     }
 }
@@ -46,8 +103,8 @@ bool Parser::expect(lexan::TokenType type, const std::string& err_msg) {
     if (match(type)) {
         return true;
     }
-    std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-              << ": Ожидалось " << err_msg << ", получено '" << current_token().value << "'\n\n";
+    Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                 << ": Ожидалось " << err_msg << ", получено '" << current_token().value << "'\n\n";
     return false;
 }
 
@@ -60,10 +117,14 @@ ASTNode* Parser::parse_program() {
     root = program_node;
 
     while (!is_at_end()) {
+        // Отдельное событие трассировки на каждое объявление верхнего уровня
+        trace::Span decl_span("parse declaration");
+        discard_consumed();
         if (current_token().type == lexan::TK_PROCEDURE) {
             ASTNode* proc = parse_procedure_decl();
             if (!proc) return nullptr;
             program_node->addChild(proc);
+            decl_span.setDetail("procedure " + proc->value);
         }
         else if (current_token().type == lexan::TK_BOOL || 
                  current_token().type == lexan::TK_INT ||
@@ -74,16 +135,18 @@ ASTNode* Parser::parse_program() {
             ASTNode* func = parse_function_decl();
             if (!func) return nullptr;
             program_node->addChild(func);
+            decl_span.setDetail("function " + func->value);
         }
         else if (current_token().type == lexan::TK_CES) {
             ASTNode* ces = parse_ces_block();
             if (!ces) return nullptr;
             program_node->addChild(ces);
+            decl_span.setDetail("ces");
         }
         else {
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректная структура программы, неожиданный токен: '" 
-                      << current_token().value << "'\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректная структура программы, неожиданный токен: '" 
+                         << current_token().value << "'\n\n";
             return nullptr;
         }
     }
@@ -98,8 +161,8 @@ ASTNode* Parser::parse_procedure_decl() {
     if (!expect(lexan::TK_ALGO, "ключевое слово 'algo'")) return nullptr;
     
     if (current_token().type != lexan::TK_IDENTIFIER) {
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Ожидался идентификатор после 'algo'\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Ожидался идентификатор после 'algo'\n\n";
         return nullptr;
     }
     
@@ -122,8 +185,8 @@ ASTNode* Parser::parse_procedure_decl() {
                 current_token().type != lexan::TK_STRING &&
                 current_token().type != lexan::TK_TIME_T &&
                 current_token().type != lexan::TK_SYMB) {
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Ожидался спецификатор типа в параметре\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Ожидался спецификатор типа в параметре\n\n";
                 delete params_node;
                 delete proc_node;
                 return nullptr;
@@ -145,8 +208,8 @@ ASTNode* Parser::parse_procedure_decl() {
             }
             
             if (current_token().type != lexan::TK_IDENTIFIER) {
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Ожидалось имя параметра\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Ожидалось имя параметра\n\n";
                 delete param_type;
                 delete params_node;
                 delete proc_node;
@@ -186,8 +249,8 @@ ASTNode* Parser::parse_procedure_decl() {
     while (current_token().type != lexan::TK_RBRACE && !is_at_end()) {
         ASTNode* stmt = parse_statement();
         if (!stmt) {
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректный оператор в теле процедуры\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректный оператор в теле процедуры\n\n";
             delete body_node;
             delete proc_node;
             return nullptr;
@@ -203,8 +266,7 @@ ASTNode* Parser::parse_procedure_decl() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::PROCEDURE_DECL, context);
     
     return proc_node;
@@ -225,8 +287,8 @@ ASTNode* Parser::parse_function_decl() {
     
     if (current_token().type != lexan::TK_IDENTIFIER) {
         delete return_type;
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Ожидался идентификатор после 'algo'\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Ожидался идентификатор после 'algo'\n\n";
         return nullptr;
     }
     
@@ -252,8 +314,8 @@ ASTNode* Parser::parse_function_decl() {
                 current_token().type != lexan::TK_SYMB) {
                 delete params_node;
                 delete func_node;
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Ожидался спецификатор типа в параметре\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Ожидался спецификатор типа в параметре\n\n";
                 return nullptr;
             }
             
@@ -276,8 +338,8 @@ ASTNode* Parser::parse_function_decl() {
                 delete param_type;
                 delete params_node;
                 delete func_node;
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Ожидалось имя параметра\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Ожидалось имя параметра\n\n";
                 return nullptr;
             }
             
@@ -313,8 +375,8 @@ ASTNode* Parser::parse_function_decl() {
     while (current_token().type != lexan::TK_RBRACE && !is_at_end()) {
         ASTNode* stmt = parse_statement();
         if (!stmt) {
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректный оператор в теле функции\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректный оператор в теле функции\n\n";
             delete body_node;
             delete func_node;
             return nullptr;
@@ -329,8 +391,7 @@ ASTNode* Parser::parse_function_decl() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::FUNCTION_DECL, context);
     
     return func_node;
@@ -350,8 +411,8 @@ ASTNode* Parser::parse_ces_block() {
         ASTNode* stmt = parse_statement();
         if (!stmt) {
             delete ces_node;
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректный оператор в блоке ces\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректный оператор в блоке ces\n\n";
             return nullptr;
         }
         ces_node->addChild(stmt);
@@ -362,8 +423,7 @@ ASTNode* Parser::parse_ces_block() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::BLOCK, context);
     
     return ces_node;
@@ -385,8 +445,8 @@ ASTNode* Parser::parse_statement() {
                 ASTNode* stmt = parse_statement();
                 if (!stmt) {
                     delete block;
-                    std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                              << ": Некорректный оператор в блоке\n\n";
+                    Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                                 << ": Некорректный оператор в блоке\n\n";
                     return nullptr;
                 }
                 block->addChild(stmt);
@@ -424,14 +484,14 @@ ASTNode* Parser::parse_statement() {
                           peek_token().type == lexan::TK_DIV_ASSIGN) {
                     return parse_assignment();
                 } else {
-                    std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                              << ": Некорректный оператор, ожидалось выражение или присваивание\n\n";
+                    Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                                 << ": Некорректный оператор, ожидалось выражение или присваивание\n\n";
                     return nullptr;
                 }
             }
             else {
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Некорректный оператор, неожиданный токен: '" << current_token().value << "'\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Некорректный оператор, неожиданный токен: '" << current_token().value << "'\n\n";
                 return nullptr;
             }
     }
@@ -467,8 +527,8 @@ ASTNode* Parser::parse_var_decl() {
     
     if (current_token().type != lexan::TK_IDENTIFIER) {
         delete type_node;
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Ожидался идентификатор после типа\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Ожидался идентификатор после типа\n\n";
         return nullptr;
     }
     
@@ -482,8 +542,8 @@ ASTNode* Parser::parse_var_decl() {
         ASTNode* init_expr = parse_expression();
         if (!init_expr) {
             delete var_node;
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректное выражение инициализации\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректное выражение инициализации\n\n";
             return nullptr;
         }
         var_node->addChild(init_expr);
@@ -494,8 +554,7 @@ ASTNode* Parser::parse_var_decl() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::VARIABLE_DECL, context);
     
     return var_node;
@@ -505,8 +564,8 @@ ASTNode* Parser::parse_assignment() {
     size_t start_pos = current_pos;
     
     if (current_token().type != lexan::TK_IDENTIFIER) {
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Ожидался идентификатор в левой части присваивания\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Ожидался идентификатор в левой части присваивания\n\n";
         return nullptr;
     }
     
@@ -521,8 +580,8 @@ ASTNode* Parser::parse_assignment() {
           op_token.type == lexan::TK_MULT_ASSIGN ||
           op_token.type == lexan::TK_DIV_ASSIGN)) {
         delete target;
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Ожидался оператор присваивания\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Ожидался оператор присваивания\n\n";
         return nullptr;
     }
     advance();
@@ -530,8 +589,8 @@ ASTNode* Parser::parse_assignment() {
     ASTNode* expr = parse_expression();
     if (!expr) {
         delete target;
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Некорректное выражение в правой части присваивания\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Некорректное выражение в правой части присваивания\n\n";
         return nullptr;
     }
     
@@ -546,8 +605,7 @@ ASTNode* Parser::parse_assignment() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::ASSIGNMENT, context);
     
     return assign_node;
@@ -564,8 +622,8 @@ ASTNode* Parser::parse_function_call() {
     bool is_ident = func_token.type == lexan::TK_IDENTIFIER;
     
     if (!is_builtin && !is_ident) {
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Некорректное начало вызова функции: " << func_name << "\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Некорректное начало вызова функции: " << func_name << "\n\n";
         return nullptr;
     }
     
@@ -582,8 +640,8 @@ ASTNode* Parser::parse_function_call() {
         do {
             ASTNode* arg = parse_expression();
             if (!arg) {
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Некорректный аргумент в вызове функции\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Некорректный аргумент в вызове функции\n\n";
                 delete args_node;
                 delete call_node;
                 return nullptr;
@@ -623,8 +681,8 @@ ASTNode* Parser::parse_do_while() {
         while (current_token().type != lexan::TK_RBRACE && !is_at_end()) {
             ASTNode* stmt = parse_statement();
             if (!stmt) {
-                std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                          << ": Некорректный оператор в теле цикла\n\n";
+                Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                             << ": Некорректный оператор в теле цикла\n\n";
                 delete body;
                 delete loop_node;
                 return nullptr;
@@ -643,8 +701,8 @@ ASTNode* Parser::parse_do_while() {
         ASTNode* stmt = parse_statement();
         if (!stmt) {
             delete loop_node;
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректный оператор в теле цикла\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректный оператор в теле цикла\n\n";
             return nullptr;
         }
         loop_node->addChild(stmt);
@@ -663,8 +721,8 @@ ASTNode* Parser::parse_do_while() {
     ASTNode* condition = parse_expression();
     if (!condition) {
         delete loop_node;
-        std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                  << ": Некорректное условие в цикле do-while\n\n";
+        Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                     << ": Некорректное условие в цикле do-while\n\n";
         return nullptr;
     }
     loop_node->addChild(condition);
@@ -679,8 +737,7 @@ ASTNode* Parser::parse_do_while() {
         return nullptr;
     }
     
-    std::vector<lexan::Token> context(tokens.begin() + start_pos, 
-                                     tokens.begin() + current_pos);
+    std::vector<lexan::Token> context = context_from(start_pos);
     check_with_fst(ASTNode::Type::DO_WHILE_LOOP, context);
     
     return loop_node;
@@ -695,8 +752,8 @@ ASTNode* Parser::parse_return() {
         ASTNode* expr = parse_expression();
         if (!expr) {
             delete return_node;
-            std::cout << "\nВ строке " << current_token().line << ", столбец " << current_token().column
-                      << ": Некорректное выражение в return\n\n";
+            Error::out() << "\nВ строке " << current_token().line << ", столбец " << current_token().column
+                         << ": Некорректное выражение в return\n\n";
             return nullptr;
         }
         return_node->addChild(expr);
@@ -919,17 +976,19 @@ ASTNode* Parser::parse_primary() {
                 }
             }
             
-            std::cout << "\nВ строке " << token.line << ", столбец " << token.column
-                      << ": Некорректное выражение, неожиданный токен: '" << token.value << "'\n\n";
+            Error::out() << "\nВ строке " << token.line << ", столбец " << token.column
+                         << ": Некорректное выражение, неожиданный токен: '" << token.value << "'\n\n";
             return nullptr;
     }
 }
 
 bool Parser::check_with_fst(ASTNode::Type node_type, const std::vector<lexan::Token>& context_tokens) {
+    stats::ScopedTimer timer(stats::STAGE_FST);
     const auto& all_rules = fst::getAllRules();
     
     for (const auto& rule : all_rules) {
         size_t matchedLength = 0;
+        stats::count(stats::COUNTER_FST_ATTEMPTS);
         if (fst::matchRule(rule, context_tokens, 0, matchedLength)) {
             return true;
         }
@@ -948,13 +1007,27 @@ bool Parser::validate_structure_with_fst(ASTNode* node) {
     return true;
 }
 
+static unsigned long long count_nodes(ASTNode* node) {
+    if (!node) return 0;
+    unsigned long long total = 1;
+    for (auto child : node->children) {
+        total += count_nodes(child);
+    }
+    return total;
+}
+
 bool Parser::parse() {
+    stats::ScopedTimer timer(stats::STAGE_PARSER);
+    TRACE_SCOPE("parse");
     root = parse_program();
     if (!root) {
-        std::cout << "\nОшибка синтаксического анализа: некорректная структура программы\n\n";
+        Error::out() << "\nОшибка синтаксического анализа: некорректная структура программы\n\n";
         return false;
     }
     
+    if (stats::active) {
+        stats::count(stats::COUNTER_AST_NODES, count_nodes(root));
+    }
     return true;
 }
 
@@ -998,15 +1071,10 @@ void Parser::print_ast(ASTNode* node, int depth, std::ostream& out) const {
 }
 
 void Parser::generate_dot_file(const std::string& filename) const {
-    std::ofstream dot_file(filename);
-    if (!dot_file.is_open()) {
-        std::cout << "\nОшибка: не удалось создать файл DOT: " << filename << "\n\n";
-        return;
-    }
-    
-    dot_file << "digraph AST {" << std::endl;
-    dot_file << "    node [shape=box, style=filled, fillcolor=lightblue];" << std::endl;
-    dot_file << "    edge [arrowhead=vee];" << std::endl;
+    std::ostringstream dot_file;
+    dot_file << "digraph AST {" << "\n";
+    dot_file << "    node [shape=box, style=filled, fillcolor=lightblue];" << "\n";
+    dot_file << "    edge [arrowhead=vee];" << "\n";
     
     std::queue<std::pair<ASTNode*, int>> nodes;
     std::unordered_map<ASTNode*, int> node_ids;
@@ -1038,61 +1106,66 @@ void Parser::generate_dot_file(const std::string& filename) const {
             default: label = "NODE";
         }
         
-        dot_file << "    " << id << " [label=\"" << label << "\"];" << std::endl;
+        dot_file << "    " << id << " [label=\"" << label << "\"];" << "\n";
         
         for (auto child : node->children) {
             if (node_ids.find(child) == node_ids.end()) {
                 node_ids[child] = next_id++;
                 nodes.push({child, node_ids[child]});
             }
-            dot_file << "    " << id << " -> " << node_ids[child] << ";" << std::endl;
+            dot_file << "    " << id << " -> " << node_ids[child] << ";" << "\n";
         }
     }
     
-    dot_file << "}" << std::endl;
-    dot_file.close();
+    dot_file << "}" << "\n";
+    if (!artifacts::write(filename, dot_file.str())) {
+        Error::out() << "\nОшибка: не удалось создать файл DOT: " << filename << "\n\n";
+    }
 }
 
 bool performSyntaxAnalysis(const std::vector<lexan::Token>& tokens, 
                           const std::string& filename,
-                          parser::Parser& parser) {
-    std::cout << "Синтаксический анализ...\n";
+                          parser::Parser& parser,
+                          bool write_ast, bool write_dot) {
+    Log::info() << "Синтаксический анализ...\n";
+    TRACE_SCOPE("performSyntaxAnalysis");
     
     if (!parser.parse()) {
-        std::cout << "Синтаксический анализ не пройден!\n";
+        Error::out() << "Синтаксический анализ не пройден!\n";
         return false;
     }
     
-    std::cout << "Синтаксический анализ успешен!\n";
-    
-    std::cout << "Сохранение AST в файл...\n";
-    std::stringstream ast_output;
-    ast_output << "=== АБСТРАКТНОЕ СИНТАКСИЧЕСКОЕ ДЕРЕВО ===\n";
-    ast_output << "Файл: " << filename << "\n";
-    ast_output << "Дата: " << FileWork::getCurrentDateTime() << "\n";
-    ast_output << "Обработано токенов: " << tokens.size() << "\n";
-    ast_output << "==============================\n\n";
+    Log::info() << "Синтаксический анализ успешен!\n";
     
-    parser.print_ast(nullptr, 0, ast_output);
-    
-    std::string ast_filename = filename + ".ast.txt";
-    FileWork::WriteFile(ast_filename, ast_output.str());
-    std::cout << "AST сохранен в: " << ast_filename << "\n";
+    if (write_ast) {
+        Log::info() << "Сохранение AST в файл...\n";
+        TRACE_SCOPE("write AST");
+        std::stringstream ast_output;
+        ast_output << "=== АБСТРАКТНОЕ СИНТАКСИЧЕСКОЕ ДЕРЕВО ===\n";
+        ast_output << "Файл: " << filename << "\n";
+        ast_output << "Дата: " << FileWork::getCurrentDateTime() << "\n";
+        ast_output << "Обработано токенов: " << tokens.size() << "\n";
+        ast_output << "==============================\n\n";
+        
+        parser.print_ast(nullptr, 0, ast_output);
+        
+        std::string ast_filename = filename + ".ast.txt";
+        FileWork::WriteFile(ast_filename, ast_output.str());
+        Log::info() << "AST сохранен в: " << ast_filename << "\n";
+    }
     
-    std::string dot_filename = filename + ".ast.dot";
-    parser.generate_dot_file(dot_filename);
-    std::cout << "DOT файл для визуализации: " << dot_filename << "\n";
+    if (write_dot) {
+        TRACE_SCOPE("write DOT");
+        std::string dot_filename = filename + ".ast.dot";
+        parser.generate_dot_file(dot_filename);
+        Log::info() << "DOT файл для визуализации: " << dot_filename << "\n";
+    }
     
     return true;
 }
 
-void writeTokenLog(const std::vector<lexan::Token>& tokens, 
-                   const std::string& filename, 
-                   const std::string& log_filename) {
+std::string tokenLogBody(const std::vector<lexan::Token>& tokens) {
     std::stringstream token_log;
-    token_log << "=== ЖУРНАЛ ТОКЕНИЗАЦИИ ===\n";
-    token_log << "Файл: " << filename << "\n";
-    token_log << "Дата: " << FileWork::getCurrentDateTime() << "\n";
     token_log << "Всего токенов: " << tokens.size() << "\n";
     token_log << "=======================\n\n";
     
@@ -1108,8 +1181,23 @@ void writeTokenLog(const std::vector<lexan::Token>& tokens,
     if (tokens.size() > max_tokens_to_log) {
         token_log << "... и еще " << (tokens.size() - max_tokens_to_log) << " токенов\n";
     }
-    
-    FileWork::WriteFile(log_filename, token_log.str());
-    std::cout << "Журнал токенов сохранен в: " << log_filename << std::endl;
+    return token_log.str();
+}
+
+void writeTokenLog(const std::string& body, const std::string& filename,
+                   const std::string& log_filename) {
+    TRACE_SCOPE("write token log");
+    std::string token_log = "=== ЖУРНАЛ ТОКЕНИЗАЦИИ ===\n";
+    token_log += "Файл: " + filename + "\n";
+    token_log += "Дата: " + FileWork::getCurrentDateTime() + "\n";
+    token_log += body;
+    FileWork::WriteFile(log_filename, token_log);
+    Log::info() << "Журнал токенов сохранен в: " << log_filename << "\n";
+}
+
+void writeTokenLog(const std::vector<lexan::Token>& tokens, 
+                   const std::string& filename, 
+                   const std::string& log_filename) {
+    writeTokenLog(tokenLogBody(tokens), filename, log_filename);
 }
 } // namespace parser
\ No newline at end of file
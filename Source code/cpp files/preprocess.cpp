@@ -3,6 +3,10 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <string_view>
+#include <set>
+#include "includes.h"
+#include "cache.h"
 
 using namespace std;
 
@@ -15,426 +19,1282 @@ static inline bool extract_quoted(const string& s, size_t start_pos, string& out
     return true;
 }
 
-short Preprocess(string input_files[], string& output_file) {
-    string log_content;
-    log_content.append("=====Preprocessor log=====\n");
+static inline bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
 
-    // 1) Read main source
-    const string main_file = input_files[0];
-    string preprocessed_code = FileWork::ReadFile(main_file);
-    if (preprocessed_code.empty()) {
-        log_content.append("Error: main file is empty or unreadable: " + main_file + "\n");
-        FileWork::WriteFile(main_file + ".log", log_content);
-        Error::ThrowConsole(5);
-        return -1;
+static bool is_word(const string& s) {
+    if (s.empty()) return false;
+    for (char c : s) {
+        if (!is_word_char(c)) return false;
     }
-    log_content.append("Main file read: " + main_file + "\n");
+    return true;
+}
 
-    // 2) Validate preprocessor section header
-    if (preprocessed_code.find("[preprocessor section begin]") == string::npos) {
-        size_t err_pos = 0;
-        int row = FileWork::FindRow(preprocessed_code, err_pos);
-        int col = FileWork::FindCol(preprocessed_code, err_pos);
-        log_content.append("Error 76 at row " + to_string(row) + ", col " + to_string(col) + "\n");
-        FileWork::WriteFile(main_file + ".log", log_content);
-        Error::ThrowConsole(76);
-        return -1;
+// Подстановка в text целых слов - имен макросов с индексом не меньше first
+static void substitute_words(const string& text, const unordered_map<string_view, size_t>& index,
+                             const vector<string>& values, size_t first, string& out,
+                             vector<size_t>* hits) {
+    size_t i = 0;
+    const size_t n = text.size();
+    while (i < n) {
+        if (!is_word_char(text[i])) {
+            size_t start = i;
+            while (i < n && !is_word_char(text[i])) i++;
+            out.append(text, start, i - start);
+            continue;
+        }
+        size_t start = i;
+        while (i < n && is_word_char(text[i])) i++;
+        auto it = index.find(string_view(text.data() + start, i - start));
+        if (it != index.end() && it->second >= first) {
+            out.append(values[it->second]);
+            if (hits) (*hits)[it->second]++;
+        } else {
+            out.append(text, start, i - start);
+        }
     }
+}
 
-    // 3) Handle ##program "name" → output_file = name.txt
-    {
-        size_t pos = preprocessed_code.find("##program");
-        if (pos != string::npos) {
-            string out_name;
-            if (!extract_quoted(preprocessed_code, pos, out_name)) {
-                int row = FileWork::FindRow(preprocessed_code, pos);
-                int col = FileWork::FindCol(preprocessed_code, pos);
-                log_content.append("Error: malformed ##program at row " + to_string(row) + ", col " + to_string(col) + "\n");
-                FileWork::WriteFile(main_file + ".log", log_content);
-                Error::ThrowConsole(77);
-                return -1;
+// Индекс имен и окончательные значения макросов для подстановки за один
+// проход. Значение макроса раскрывается только объявленными после него;
+// при повторном объявлении действует первое. Имена не из символов слова
+// попадают в other
+static void resolve_macros(const vector<pair<string, string>>& macros,
+                           unordered_map<string_view, size_t>& index, vector<string>& values,
+                           vector<pair<string, string>>& other) {
+    for (size_t i = 0; i < macros.size(); i++) {
+        if (!is_word(macros[i].first)) {
+            other.push_back(macros[i]);
+            continue;
+        }
+        index.emplace(macros[i].first, i);
+    }
+
+    // Значения раскрываются с конца: к моменту обработки макроса i
+    // значения всех более поздних уже окончательные
+    values.assign(macros.size(), string());
+    for (size_t i = macros.size(); i-- > 0; ) {
+        auto it = index.find(macros[i].first);
+        if (it == index.end() || it->second != i) continue;
+        substitute_words(macros[i].second, index, values, i + 1, values[i], nullptr);
+    }
+}
+
+static string expand_macros(const string& code, const vector<pair<string, string>>& macros,
+                            string& log_content) {
+    unordered_map<string_view, size_t> index;
+    vector<string> values;
+    vector<pair<string, string>> other;     // Имена не из символов слова
+    resolve_macros(macros, index, values, other);
+
+    string result;
+    result.reserve(code.size());
+    vector<size_t> hits(macros.size(), 0);
+    substitute_words(code, index, values, 0, result, &hits);
+
+    for (size_t i = 0; i < macros.size(); i++) {
+        if (hits[i] > 0) {
+            log_content.append("  Replaced " + macros[i].first + " with " + macros[i].second +
+                               " (" + to_string(hits[i]) + ")\n");
+        }
+    }
+
+    // Редкий случай имени с другими символами - прежний поиск подстроки
+    for (const auto& macro : other) {
+        size_t replace_pos = 0;
+        while ((replace_pos = result.find(macro.first, replace_pos)) != string::npos) {
+            size_t after = replace_pos + macro.first.length();
+            bool is_whole_word = (replace_pos == 0 || !is_word_char(result[replace_pos - 1])) &&
+                                 (after >= result.length() || !is_word_char(result[after]));
+            if (is_whole_word) {
+                result.replace(replace_pos, macro.first.length(), macro.second);
+                replace_pos += macro.second.length();
+                log_content.append("  Replaced " + macro.first + " with " + macro.second + "\n");
+            } else {
+                replace_pos = after;
             }
-            output_file = out_name + ".txt";
-            log_content.append("Output filename set to: " + output_file + "\n");
-            
-            // Remove ##program directive
-            size_t line_end = preprocessed_code.find('\n', pos);
-            if (line_end == string::npos) line_end = preprocessed_code.size();
-            preprocessed_code.erase(pos, line_end - pos + 1);
-        } else {
-            // default: derive from main_file
-            size_t dot = main_file.find_last_of('.');
-            output_file = (dot == string::npos) ? (main_file + ".txt")
-                                               : (main_file.substr(0, dot) + ".txt");
-            log_content.append("Output filename derived: " + output_file + "\n");
         }
     }
+    return result;
+}
 
-    // 4) Handle ##inaddition "file" - insert functions and macros
-    {
-        size_t pos = 0;
-        int added_count = 0;
-        
-        while ((pos = preprocessed_code.find("##inaddition", pos)) != string::npos) {
-            // Extract filename from quotes
-            size_t quote_start = preprocessed_code.find('"', pos);
-            if (quote_start == string::npos) {
-                int row = FileWork::FindRow(preprocessed_code, pos);
-                int col = FileWork::FindCol(preprocessed_code, pos);
-                log_content.append("Error: malformed ##inaddition at row " + to_string(row) +
-                                   ", col " + to_string(col) + "\n");
-                FileWork::WriteFile(main_file + ".log", log_content);
-                Error::ThrowConsole(78);
-                return -1;
+// Значение константного выражения ##perceive: целое или строка
+struct ConstValue {
+    bool is_string;
+    long long number;
+    string text;        // Содержимое строки без кавычек, как в исходном тексте
+
+    ConstValue() : is_string(false), number(0) {}
+};
+
+// Целые сгенерированного JavaScript точны до 2^53: дальше не сворачивается
+static const long long CONST_LIMIT = (1LL << 53) - 1;
+
+// Разбор выражения: + - * / % над целыми, + над строками, скобки,
+// унарные + и -, имена ранее свернутых макросов. Любая другая
+// конструкция (дробные числа, вызовы, неизвестные имена) - отказ,
+// и значение подставляется как текст, как раньше
+class ConstFolder {
+private:
+    const string& text;
+    const unordered_map<string, ConstValue>& known;
+    size_t pos;
+
+    void skip_spaces() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) pos++;
+    }
+
+    static bool in_range(long long value) {
+        return value >= -CONST_LIMIT && value <= CONST_LIMIT;
+    }
+
+    bool primary(ConstValue& value) {
+        skip_spaces();
+        if (pos >= text.size()) return false;
+        char c = text[pos];
+
+        if (c == '(') {
+            pos++;
+            if (!sum(value)) return false;
+            skip_spaces();
+            if (pos >= text.size() || text[pos] != ')') return false;
+            pos++;
+            return true;
+        }
+        if (c == '-' || c == '+') {
+            pos++;
+            if (!primary(value) || value.is_string) return false;
+            if (c == '-') value.number = -value.number;
+            return true;
+        }
+        if (c == '"') {
+            size_t start = ++pos;
+            while (pos < text.size() && text[pos] != '"') {
+                if (text[pos] == '\\') pos++;
+                pos++;
             }
-            
-            size_t quote_end = preprocessed_code.find('"', quote_start + 1);
-            if (quote_end == string::npos) {
-                int row = FileWork::FindRow(preprocessed_code, pos);
-                int col = FileWork::FindCol(preprocessed_code, pos);
-                log_content.append("Error: malformed ##inaddition at row " + to_string(row) +
-                                   ", col " + to_string(col) + "\n");
-                FileWork::WriteFile(main_file + ".log", log_content);
-                Error::ThrowConsole(78);
-                return -1;
+            if (pos >= text.size()) return false;
+            value.is_string = true;
+            value.text = text.substr(start, pos - start);
+            pos++;
+            return true;
+        }
+        if (c >= '0' && c <= '9') {
+            int base = 10;
+            size_t start = pos;
+            if (c == '0' && pos + 1 < text.size() && text[pos + 1] == 'x') {
+                base = 16;
+                start = pos += 2;
             }
-            
-            string add_filename = preprocessed_code.substr(quote_start + 1, 
-                                                         quote_end - quote_start - 1);
-            
-            // Read additional file
-            string additional_code = FileWork::ReadFile(add_filename);
-            if (additional_code.empty()) {
-                log_content.append("Warning: additional file empty or not found: " + 
-                                   add_filename + "\n");
-                
-                // Remove directive anyway
-                size_t line_end = preprocessed_code.find('\n', pos);
-                if (line_end == string::npos) line_end = preprocessed_code.size();
-                preprocessed_code.erase(pos, line_end - pos + 1);
-                continue;
+            long long number = 0;
+            while (pos < text.size()) {
+                char d = text[pos];
+                int digit;
+                if (d >= '0' && d <= '9') digit = d - '0';
+                else if (base == 16 && d >= 'a' && d <= 'f') digit = d - 'a' + 10;
+                else if (base == 16 && d >= 'A' && d <= 'F') digit = d - 'A' + 10;
+                else break;
+                number = number * base + digit;
+                if (!in_range(number)) return false;
+                pos++;
             }
-            
-            log_content.append("Processing additional file: " + add_filename + "\n");
-            
-            // Try both singular and plural markers for function section
-            string func_begin_marker = "[function section begin]";
-            string func_end_marker = "[function section end]";
-            
-            size_t func_begin = additional_code.find(func_begin_marker);
-            size_t func_end = additional_code.find(func_end_marker);
-            
-            // If not found with singular, try plural
-            if (func_begin == string::npos || func_end == string::npos) {
-                func_begin_marker = "[functions section begin]";
-                func_end_marker = "[functions section end]";
-                func_begin = additional_code.find(func_begin_marker);
-                func_end = additional_code.find(func_end_marker);
+            // 0xx (восьмеричные, в том числе 007), дробные и числа с суффиксом
+            // не сворачиваются
+            if (pos == start || (base == 10 && text[start] == '0' && pos - start > 1) ||
+                (pos < text.size() && (is_word_char(text[pos]) || text[pos] == '.'))) {
+                return false;
             }
-            
-            if (func_begin != string::npos && func_end != string::npos && func_end > func_begin) {
-                // Extract functions (excluding markers)
-                string functions = additional_code.substr(
-                    func_begin + func_begin_marker.length(), 
-                    func_end - func_begin - func_begin_marker.length()
-                );
-                
-                // Find where to insert in main file (try both singular and plural)
-                string target_marker = "[functions section begin]";
-                size_t insert_pos = preprocessed_code.find(target_marker);
-                
-                if (insert_pos == string::npos) {
-                    // Try singular
-                    target_marker = "[function section begin]";
-                    insert_pos = preprocessed_code.find(target_marker);
-                }
-                
-                if (insert_pos != string::npos) {
-                    // Insert after the marker
-                    size_t insert_after = insert_pos + target_marker.length();
-                    
-                    // Trim leading/trailing whitespace from functions
-                    size_t func_start = functions.find_first_not_of(" \t\n\r");
-                    if (func_start != string::npos) {
-                        size_t func_end_pos = functions.find_last_not_of(" \t\n\r");
-                        functions = functions.substr(func_start, func_end_pos - func_start + 1);
-                    }
-                    
-                    preprocessed_code.insert(insert_after, "\n" + functions + "\n");
-                    
-                    log_content.append("Successfully inserted functions from " + 
-                                       add_filename + " after " + target_marker + "\n");
-                    added_count++;
-                } else {
-                    log_content.append("Warning: function section marker not found in main file\n");
+            value.is_string = false;
+            value.number = number;
+            return true;
+        }
+        if (is_word_char(c)) {
+            size_t start = pos;
+            while (pos < text.size() && is_word_char(text[pos])) pos++;
+            auto it = known.find(text.substr(start, pos - start));
+            if (it == known.end()) return false;
+            value = it->second;
+            return true;
+        }
+        return false;
+    }
+
+    bool product(ConstValue& value) {
+        if (!primary(value)) return false;
+        for (;;) {
+            skip_spaces();
+            if (pos >= text.size() || (text[pos] != '*' && text[pos] != '/' && text[pos] != '%')) {
+                return true;
+            }
+            char op = text[pos++];
+            ConstValue right;
+            if (!primary(right) || value.is_string || right.is_string) return false;
+            long long a = value.number, b = right.number;
+            if (op == '*') {
+                if (a != 0 && (b > CONST_LIMIT / (a < 0 ? -a : a) || b < -CONST_LIMIT / (a < 0 ? -a : a))) {
+                    return false;
                 }
+                value.number = a * b;
             } else {
-                log_content.append("Warning: function section not found in " + 
-                                   add_filename + " (tried both singular and plural markers)\n");
+                // Деление в JavaScript дробное: сворачивается только нацело
+                if (b == 0 || (op == '/' && a % b != 0)) return false;
+                value.number = (op == '/') ? a / b : a % b;
             }
-            
-            // Extract and add ##perceive macros from additional file
-            size_t macro_pos = 0;
-            while ((macro_pos = additional_code.find("##perceive", macro_pos)) != string::npos) {
-                size_t line_end = additional_code.find('\n', macro_pos);
-                if (line_end == string::npos) line_end = additional_code.size();
-                
-                string macro_line = additional_code.substr(macro_pos, line_end - macro_pos);
-                
-                // Find preprocessor section end in main file to insert before it
-                size_t pp_end = preprocessed_code.find("[preprocessor section end]");
-                if (pp_end != string::npos) {
-                    preprocessed_code.insert(pp_end, macro_line + "\n");
-                    log_content.append("Added macro from " + add_filename + ": " + macro_line + "\n");
+        }
+    }
+
+    bool sum(ConstValue& value) {
+        if (!product(value)) return false;
+        for (;;) {
+            skip_spaces();
+            if (pos >= text.size() || (text[pos] != '+' && text[pos] != '-')) {
+                return true;
+            }
+            char op = text[pos++];
+            ConstValue right;
+            if (!product(right) || value.is_string != right.is_string) return false;
+            if (value.is_string) {
+                if (op != '+') return false;
+                value.text += right.text;
+                continue;
+            }
+            value.number = (op == '+') ? value.number + right.number : value.number - right.number;
+            if (!in_range(value.number)) return false;
+        }
+    }
+
+public:
+    ConstFolder(const string& t, const unordered_map<string, ConstValue>& k)
+        : text(t), known(k), pos(0) {}
+
+    bool evaluate(ConstValue& value) {
+        if (!sum(value)) return false;
+        skip_spaces();
+        return pos == text.size();
+    }
+};
+
+// Запись значения одним литералом. Отрицательное - в скобках, чтобы
+// подстановка после "-" не дала "--"
+static string const_literal(const ConstValue& value) {
+    if (value.is_string) return "\"" + value.text + "\"";
+    return value.number < 0 ? "(" + to_string(value.number) + ")" : to_string(value.number);
+}
+
+// Вычисление значений ##perceive - константных выражений один раз, до
+// подстановки: LIMIT со значением SIZE*60*60 попадает в текст одним
+// числом. Ссылаться можно на объявленные раньше макросы; в значения,
+// которые не свернулись, их литералы подставляются как текст
+static void fold_constants(vector<pair<string, string>>& macros, string& log_content) {
+    unordered_map<string, ConstValue> known;
+    for (auto& macro : macros) {
+        ConstValue value;
+        if (!ConstFolder(macro.second, known).evaluate(value)) {
+            if (known.empty()) continue;
+            string substituted;
+            const string& text = macro.second;
+            for (size_t i = 0; i < text.size(); ) {
+                size_t start = i;
+                if (!is_word_char(text[i])) {
+                    while (i < text.size() && !is_word_char(text[i])) i++;
+                    substituted.append(text, start, i - start);
+                    continue;
                 }
-                
-                macro_pos = (line_end == additional_code.size()) ? line_end : (line_end + 1);
+                while (i < text.size() && is_word_char(text[i])) i++;
+                auto it = known.find(text.substr(start, i - start));
+                substituted.append(it != known.end() ? const_literal(it->second)
+                                                     : text.substr(start, i - start));
             }
+            macro.second.swap(substituted);
+            continue;
+        }
+        string literal = const_literal(value);
+        if (literal != macro.second) {
+            log_content.append("Folded " + macro.first + ": " + macro.second + " = " + literal + "\n");
+            macro.second = literal;
+        }
+        // При повторном объявлении действует первое
+        known.emplace(macro.first, value);
+    }
+}
+
+// Основа имен артефактов: имя программы без расширения или, если до него
+// препроцессор не дошел (ошибка в заголовке), имя главного файла
+static string artifact_base(const string& program_file, const string& main_file) {
+    string base_name = program_file.empty() ? main_file : program_file;
+    size_t dot_pos = base_name.find_last_of('.');
+    if (dot_pos != string::npos) {
+        base_name = base_name.substr(0, dot_pos);
+    }
+    return base_name;
+}
+
+// Файл программы не перекодирован из UTF-8 (-utf8): ошибка 6 уже выдана,
+// препроцессор не продолжает с его пустым текстом
+static short check_transcoding(short result, string& log_content) {
+    FileWork::SourceManager* sources = FileWork::SourceManager::current();
+    if (result == 0 && sources && sources->transcodeFailed()) {
+        log_content.append("Error: source file could not be transcoded from UTF-8\n");
+        return -1;
+    }
+    return result;
+}
 
-            // Remove the ##inaddition directive
-            size_t line_end = preprocessed_code.find('\n', pos);
-            if (line_end == string::npos) line_end = preprocessed_code.size();
-            preprocessed_code.erase(pos, line_end - pos + 1);
-            
-            // Continue searching from the beginning (since we modified the string)
-            pos = 0;
+// Журнал препроцессора пишется и при ошибке - в нем ее позиция
+static void write_log(const string& log_file, const string& log_content, PreprocessLog* log) {
+    if (log) {
+        log->filename = log_file;
+        log->content = log_content;
+    }
+    FileWork::WriteFile(log_file, log_content);
+}
+
+short Preprocess(string input_files[], string& output_file) {
+    string preprocessed_code;
+    return Preprocess(input_files, output_file, preprocessed_code, true);
+}
+
+short Preprocess(string input_files[], string& output_file, string& preprocessed_code,
+                 bool write_prep_file, const DefineList& defines, PreprocessLog* log) {
+    // 1) Read main source
+    const string main_file = input_files[0];
+    string log_content;
+    string storage;
+    string program_file;
+    short result = PreprocessSource(main_file, FileWork::SourceText(main_file, storage), program_file,
+                                    preprocessed_code, log_content, IncludeResolver(), defines);
+    result = check_transcoding(result, log_content);
+
+    // 10) Write output files
+    string base_name = artifact_base(program_file, main_file);
+    string log_file = base_name + ".log";
+    string prep_file = base_name + "_prep.txt";
+    if (result != 0) {
+        write_log(log_file, log_content, log);
+        return result;
+    }
+    
+    // Write preprocessed code (только если нужен как артефакт - следующие
+    // этапы получают буфер напрямую)
+    if (write_prep_file && FileWork::WriteFile(prep_file, preprocessed_code) != 0) {
+        log_content.append("Error: could not write preprocessed file\n");
+    }
+    
+    // Write log
+    write_log(log_file, log_content, log);
+    
+    // Set output file for next stages (имя используется как основа для артефактов)
+    output_file = prep_file;
+    
+    Log::info() << "Preprocessing completed successfully!\n";
+    if (write_prep_file) {
+        Log::info() << "  Output file: " << prep_file << "\n";
+    }
+    Log::info() << "  Log file:    " << log_file << "\n";
+    
+    return 0;
+}
+
+short PreprocessTokens(string input_files[], string& output_file, std::vector<lexan::Token>& tokens,
+                       std::vector<string>& files, const DefineList& defines, PreprocessLog* log) {
+    const string main_file = input_files[0];
+    string log_content;
+    string storage;
+    string program_file;
+    short result = TokenizeSource(main_file, FileWork::SourceText(main_file, storage), program_file,
+                                  tokens, files, log_content, IncludeResolver(), defines);
+    result = check_transcoding(result, log_content);
+
+    // Имена артефактов - как после Preprocess, хотя _prep.txt не создается
+    string base_name = artifact_base(program_file, main_file);
+    string log_file = base_name + ".log";
+    write_log(log_file, log_content, log);
+    if (result != 0) {
+        return result;
+    }
+    output_file = base_name + "_prep.txt";
+
+    Log::info() << "Preprocessing and lexical analysis completed successfully!\n";
+    Log::info() << "  Log file:    " << log_file << "\n";
+    return 0;
+}
+
+static const char* const PP_END_MARKER = "[preprocessor section end]";
+static const size_t MAX_INCLUDE_DEPTH = 32;
+
+// Отрезок [begin, end) исходного текста source (0 - главный файл,
+// k - функции k-го файла ##inaddition)
+struct Segment {
+    size_t source;
+    size_t begin;
+    size_t end;
+};
+
+// Выход прохода по директивам: новый текст или, для лексера без
+// промежуточного текста (-fused), отрезки исходного текста source
+struct ScanOutput {
+    bool segmented;
+    size_t source;
+    string text;
+    vector<Segment> segments;
+
+    ScanOutput(bool s, size_t src) : segmented(s), source(src) {}
+
+    // Как string::append(from, pos, n)
+    void append(const string& from, size_t pos, size_t n) {
+        n = std::min(n, from.size() - pos);
+        if (!segmented) {
+            text.append(from, pos, n);
+        } else if (n > 0) {
+            segments.push_back({source, pos, pos + n});
         }
-        
-        log_content.append("Processed ##inaddition directives: " + 
-                          to_string(added_count) + "\n");
     }
+    void reserve(size_t n) {
+        if (!segmented) text.reserve(n);
+    }
+    size_t size() const {
+        return segmented ? segments.size() : text.size();
+    }
+};
 
-    // 5) Process all ##perceive macros
-    {
-        vector<pair<string, string>> macros;
-        
-        // First pass: collect all macros
-        size_t pos = 0;
-        while ((pos = preprocessed_code.find("##perceive", pos)) != string::npos) {
-            size_t line_end = preprocessed_code.find('\n', pos);
-            if (line_end == string::npos) line_end = preprocessed_code.size();
-            
-            string macro_line = preprocessed_code.substr(pos, line_end - pos);
-            
-            // Parse macro: ##perceive NAME VALUE
-            size_t name_start = pos + 10; // Skip "##perceive"
-            while (name_start < line_end && (preprocessed_code[name_start] == ' ' || preprocessed_code[name_start] == '\t')) {
-                name_start++;
-            }
-            
-            size_t name_end = name_start;
-            while (name_end < line_end && preprocessed_code[name_end] != ' ' && preprocessed_code[name_end] != '\t') {
-                name_end++;
+// Состояние прохода по директивам (шаги 3-5)
+struct DirectiveScan {
+    const IncludeResolver& resolver;
+    string& log_content;
+    string functions_marker;            // Маркер главного файла, после которого вставляются функции
+    bool has_pp_end;                    // В главном файле есть [preprocessor section end]
+
+    bool program_seen;
+    bool macros_stopped;                // После ошибки в ##perceive остальные не обрабатываются
+    vector<pair<string, string>> macros;
+    vector<string> pending_macros;      // Макросы файлов ##inaddition до [preprocessor section end]
+    bool pp_end_seen;
+    size_t pp_end_index;                // Место макросов ##inaddition в порядке объявления
+    set<string> included;               // Уже включенные файлы (includes::canonicalName)
+    vector<string> include_names;       // Они же под именами из директив, в порядке включения
+    vector<string> include_stack;       // Цепочка включения текущего файла
+    vector<ScanOutput> included_functions;  // В порядке обработки; вставляются в обратном
+    vector<vector<pair<string, string>>> function_macros;   // ##perceive внутри этих функций
+    size_t functions_at;                // Позиция вставки функций в выходном тексте
+    size_t functions_index;             // Место их макросов в порядке объявления
+    int added_count;
+    bool segmented;                     // Выход - отрезки исходных текстов (ScanOutput)
+    // Источники отрезков: файлы ##inaddition с функциями, с 1
+    vector<std::shared_ptr<const includes::Library>> libraries;
+    vector<string> library_names;
+
+    DirectiveScan(const IncludeResolver& r, string& log)
+        : resolver(r), log_content(log), has_pp_end(false), program_seen(false),
+          macros_stopped(false), pp_end_seen(false), pp_end_index(0),
+          functions_at(string::npos), functions_index(0), added_count(0), segmented(false) {}
+};
+
+static inline size_t line_end_of(const string& text, size_t pos) {
+    size_t line_end = text.find('\n', pos);
+    return line_end == string::npos ? text.size() : line_end;
+}
+
+// Имя и значение из строки "##perceive NAME VALUE"; при ошибке - ее текст в error
+static bool split_macro(const string& line, string& macro_name, string& macro_value,
+                        const char*& error) {
+    size_t name_start = 10; // Skip "##perceive"
+    while (name_start < line.size() && (line[name_start] == ' ' || line[name_start] == '\t')) {
+        name_start++;
+    }
+
+    size_t name_end = name_start;
+    while (name_end < line.size() && line[name_end] != ' ' && line[name_end] != '\t') {
+        name_end++;
+    }
+    if (name_end >= line.size()) {
+        error = "Error: invalid ##perceive format\n";
+        return false;
+    }
+
+    size_t value_start = name_end;
+    while (value_start < line.size() && (line[value_start] == ' ' || line[value_start] == '\t')) {
+        value_start++;
+    }
+    if (value_start >= line.size()) {
+        error = "Error: missing value in ##perceive\n";
+        return false;
+    }
+
+    macro_name = line.substr(name_start, name_end - name_start);
+    macro_value = line.substr(value_start);
+
+    // Trim trailing whitespace from value
+    size_t value_end = macro_value.find_last_not_of(" \t\r");
+    if (value_end != string::npos) {
+        macro_value.resize(value_end + 1);
+    }
+    return true;
+}
+
+// Разбор строки "##perceive NAME VALUE" в macros; false - строка некорректна
+static bool parse_macro(const string& line, DirectiveScan& scan,
+                        vector<pair<string, string>>& macros) {
+    string macro_name, macro_value;
+    const char* error = nullptr;
+    if (!split_macro(line, macro_name, macro_value, error)) {
+        scan.log_content.append(error);
+        return false;
+    }
+
+    macros.push_back({macro_name, macro_value});
+    scan.log_content.append("Macro defined: " + macro_name + " = " + macro_value + "\n");
+    return true;
+}
+
+// Макрос файла ##inaddition занимает место перед [preprocessor section end]
+static void add_included_macro(const string& line, DirectiveScan& scan) {
+    if (!scan.pp_end_seen) {
+        scan.pending_macros.push_back(line);
+        return;
+    }
+    if (scan.macros_stopped) {
+        return;
+    }
+    size_t before = scan.macros.size();
+    if (!parse_macro(line, scan, scan.macros)) {
+        scan.macros_stopped = true;
+        return;
+    }
+    if (scan.pp_end_index < before) {
+        auto macro = scan.macros.back();
+        scan.macros.pop_back();
+        scan.macros.insert(scan.macros.begin() + scan.pp_end_index, macro);
+    }
+    if (scan.functions_at != string::npos && scan.functions_index >= scan.pp_end_index) {
+        scan.functions_index++;
+    }
+    scan.pp_end_index++;
+}
+
+static short scan_directives(const string& text, DirectiveScan& scan, ScanOutput& out,
+                             size_t slot, size_t depth);
+static const size_t MAIN_FILE = static_cast<size_t>(-1);
+
+// Секция функций файла ##inaddition и его макросы. Файл читается и
+// разбирается через кэш includes.h; повторное включение и цикл пропускаются
+static short include_file(const string& add_filename, DirectiveScan& scan, size_t depth) {
+    string key = includes::canonicalName(add_filename, static_cast<bool>(scan.resolver));
+
+    auto on_stack = std::find(scan.include_stack.begin(), scan.include_stack.end(), key);
+    if (on_stack != scan.include_stack.end()) {
+        string chain;
+        for (auto it = on_stack; it != scan.include_stack.end(); ++it) {
+            chain += *it + " -> ";
+        }
+        scan.log_content.append("Warning: ##inaddition cycle skipped: " + chain + key + "\n");
+        return 0;
+    }
+    // Отклоненный файл не записывается во включенные: ключ кэша и -watch
+    // не должны от него зависеть
+    if (depth >= MAX_INCLUDE_DEPTH) {
+        scan.log_content.append("Warning: ##inaddition nesting too deep, skipped: " + add_filename + "\n");
+        return 0;
+    }
+    if (!scan.included.insert(key).second) {
+        scan.log_content.append("Warning: duplicate ##inaddition skipped: " + add_filename + "\n");
+        return 0;
+    }
+    scan.include_names.push_back(add_filename);
+
+    bool cached = false;
+    std::shared_ptr<const includes::Library> library = includes::load(add_filename, scan.resolver, &cached);
+    if (!library) {
+        scan.log_content.append("Warning: additional file empty or not found: " +
+                                add_filename + "\n");
+        return 0;
+    }
+    scan.log_content.append("Processing additional file: " + add_filename +
+                            (cached ? " (cached)\n" : "\n"));
+
+    if (library->has_functions) {
+        if (!scan.functions_marker.empty()) {
+            // Место резервируется до разбора: вложенные ##inaddition
+            // обрабатываются позже и оказываются перед этими функциями
+            size_t slot = scan.included_functions.size();
+            scan.included_functions.emplace_back(scan.segmented, 0);
+            scan.function_macros.emplace_back();
+            scan.libraries.push_back(library);
+            scan.library_names.push_back(add_filename);
+            ScanOutput scanned(scan.segmented, scan.libraries.size());
+            scan.include_stack.push_back(key);
+            short result = scan_directives(library->functions, scan, scanned, slot, depth + 1);
+            scan.include_stack.pop_back();
+            if (result != 0) {
+                return result;
             }
-            
-            if (name_end >= line_end) {
-                log_content.append("Error: invalid ##perceive format\n");
-                break;
+            scan.included_functions[slot] = std::move(scanned);
+
+            scan.log_content.append("Successfully inserted functions from " +
+                                    add_filename + " after " + scan.functions_marker + "\n");
+            scan.added_count++;
+        } else {
+            scan.log_content.append("Warning: function section marker not found in main file\n");
+        }
+    } else {
+        scan.log_content.append("Warning: function section not found in " +
+                                add_filename + " (tried both singular and plural markers)\n");
+    }
+
+    // ##perceive macros from additional file
+    if (scan.has_pp_end) {
+        for (const auto& macro_line : library->macro_lines) {
+            add_included_macro(macro_line, scan);
+            scan.log_content.append("Added macro from " + add_filename + ": " + macro_line + "\n");
+        }
+    }
+    return 0;
+}
+
+// Значение макроса для условия ##when: определенные к этому месту
+// (-D, главный файл, функции ##inaddition), затем ожидающие
+// [preprocessor section end]; как и при подстановке, первое определение
+static bool find_macro(const DirectiveScan& scan, const string& name, string& value) {
+    for (const auto& macro : scan.macros) {
+        if (macro.first == name) {
+            value = macro.second;
+            return true;
+        }
+    }
+    for (const auto& macros : scan.function_macros) {
+        for (const auto& macro : macros) {
+            if (macro.first == name) {
+                value = macro.second;
+                return true;
             }
-            
-            string macro_name = preprocessed_code.substr(name_start, name_end - name_start);
-            
-            size_t value_start = name_end;
-            while (value_start < line_end && (preprocessed_code[value_start] == ' ' || preprocessed_code[value_start] == '\t')) {
-                value_start++;
+        }
+    }
+    for (const auto& line : scan.pending_macros) {
+        string macro_name, macro_value;
+        const char* error = nullptr;
+        if (split_macro(line, macro_name, macro_value, error) && macro_name == name) {
+            value = macro_value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline string trim(const string& s) {
+    size_t start = s.find_first_not_of(" \t\r");
+    if (start == string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(start, end - start + 1);
+}
+
+// Условие ##when: NAME, !NAME, NAME == VALUE, NAME != VALUE.
+// NAME истинно, если макрос определен и его значение не 0, false и не пусто;
+// значения сравниваются как текст. false - условие записано некорректно
+static bool evaluate_condition(const string& condition, const DirectiveScan& scan, bool& result) {
+    string expr = trim(condition);
+    size_t op = expr.find("==");
+    if (op == string::npos) op = expr.find("!=");
+
+    if (op != string::npos) {
+        string name = trim(expr.substr(0, op));
+        string expected = trim(expr.substr(op + 2));
+        if (!is_word(name) || expected.empty()) return false;
+        string value;
+        find_macro(scan, name, value);
+        result = (value == expected) == (expr[op] == '=');
+        return true;
+    }
+
+    bool negate = !expr.empty() && expr[0] == '!';
+    string name = trim(negate ? expr.substr(1) : expr);
+    if (!is_word(name)) return false;
+    string value;
+    bool defined = find_macro(scan, name, value);
+    result = (defined && !value.empty() && value != "0" && value != "false") != negate;
+    return true;
+}
+
+// Открытый ##when текущего текста
+struct Branch {
+    bool outer;         // Активна ли охватывающая область
+    bool taken;         // Условие истинно
+    bool otherwise;     // Уже был ##otherwise
+    size_t pos;         // Позиция ##when для сообщения об ошибке
+};
+
+// Ошибка в позиции pos текста text: в журнал и на консоль со строкой и
+// столбцом; для файла ##inaddition к сообщению добавляется его имя
+static short preprocess_error(const string& text, size_t pos, const string& what,
+                              unsigned short code, DirectiveScan& scan) {
+    int row, col;
+    FileWork::LineIndex(text).locate(pos, row, col);
+    scan.log_content.append("Error: " + what + " at row " + to_string(row) +
+                            ", col " + to_string(col) + "\n");
+    Error::ThrowConsole(code, row, col, false,
+                        scan.include_stack.empty() ? string() : scan.include_stack.back());
+    return -1;
+}
+
+// ##when / ##otherwise / ##endwhen в позиции pos; active - включен ли текст после директивы
+static short when_directive(const string& text, size_t pos, size_t line_end, DirectiveScan& scan,
+                         vector<Branch>& branches, bool& active) {
+    if (text.compare(pos, 9, "##endwhen") == 0) {
+        if (branches.empty()) {
+            return preprocess_error(text, pos, "##endwhen without ##when", 80, scan);
+        }
+        active = branches.back().outer;
+        branches.pop_back();
+        return 0;
+    }
+
+    if (text.compare(pos, 11, "##otherwise") == 0) {
+        if (branches.empty() || branches.back().otherwise) {
+            return preprocess_error(text, pos, "##otherwise without ##when", 80, scan);
+        }
+        Branch& branch = branches.back();
+        branch.otherwise = true;
+        active = branch.outer && !branch.taken;
+        return 0;
+    }
+
+    bool value = false;
+    if (active) {
+        string condition = text.substr(pos + 6, line_end - pos - 6);
+        if (!evaluate_condition(condition, scan, value)) {
+            return preprocess_error(text, pos, "malformed ##when condition", 81, scan);
+        }
+        scan.log_content.append("Condition " + trim(condition) + ": " + (value ? "true" : "false") + "\n");
+    }
+    branches.push_back({active, value, false, pos});
+    active = active && value;
+    return 0;
+}
+
+// Один проход по тексту: директивы ##program, ##inaddition и ##perceive
+// удаляются вместе с концом строки, остальное копируется в out.
+// slot - номер функций ##inaddition или MAIN_FILE для главного файла
+static short scan_directives(const string& text, DirectiveScan& scan, ScanOutput& out,
+                             size_t slot, size_t depth) {
+    const bool is_main = (slot == MAIN_FILE);
+    out.reserve(out.size() + text.size());
+    size_t copied = 0;
+    size_t pos = 0;
+    // Условная компиляция: текст неактивной ветви не копируется,
+    // директивы в нем не выполняются
+    vector<Branch> branches;
+    bool active = true;
+
+    while ((pos = text.find_first_of("#[", pos)) != string::npos) {
+        if (text[pos] == '[') {
+            if (!is_main || !active) {
+                pos++;
+                continue;
             }
-            
-            if (value_start >= line_end) {
-                log_content.append("Error: missing value in ##perceive\n");
-                break;
+            if (!scan.pp_end_seen && text.compare(pos, strlen(PP_END_MARKER), PP_END_MARKER) == 0) {
+                scan.pp_end_seen = true;
+                for (const auto& line : scan.pending_macros) {
+                    if (scan.macros_stopped) break;
+                    if (!parse_macro(line, scan, scan.macros)) scan.macros_stopped = true;
+                }
+                scan.pending_macros.clear();
+                scan.pp_end_index = scan.macros.size();
+            } else if (scan.functions_at == string::npos && !scan.functions_marker.empty() &&
+                       text.compare(pos, scan.functions_marker.size(), scan.functions_marker) == 0) {
+                size_t marker_end = pos + scan.functions_marker.size();
+                out.append(text, copied, marker_end - copied);
+                copied = marker_end;
+                scan.functions_at = out.size();
+                scan.functions_index = scan.macros.size();
+                pos = marker_end;
+                continue;
             }
-            
-            string macro_value = preprocessed_code.substr(value_start, line_end - value_start);
-            
-            // Trim trailing whitespace from value
-            size_t value_end = macro_value.find_last_not_of(" \t\r");
-            if (value_end != string::npos) {
-                macro_value = macro_value.substr(0, value_end + 1);
+            pos++;
+            continue;
+        }
+
+        if (text.compare(pos, 2, "##") != 0) {
+            pos++;
+            continue;
+        }
+
+        size_t line_end = line_end_of(text, pos);
+        size_t next = (line_end == text.size()) ? line_end : line_end + 1;
+
+        if (text.compare(pos, 6, "##when") == 0 || text.compare(pos, 11, "##otherwise") == 0 ||
+            text.compare(pos, 9, "##endwhen") == 0) {
+            if (active) {
+                out.append(text, copied, pos - copied);
             }
-            
-            macros.push_back({macro_name, macro_value});
-            log_content.append("Macro defined: " + macro_name + " = " + macro_value + "\n");
-            
-            // Remove macro line
-            preprocessed_code.erase(pos, line_end - pos + 1);
-        }
-        
-        // Second pass: replace all occurrences of macros
-        for (const auto& macro : macros) {
-            size_t replace_pos = 0;
-            while ((replace_pos = preprocessed_code.find(macro.first, replace_pos)) != string::npos) {
-                // Check if it's a whole word (not part of another identifier)
-                bool is_whole_word = true;
-                if (replace_pos > 0) {
-                    char prev = preprocessed_code[replace_pos - 1];
-                    if (isalnum(prev) || prev == '_') {
-                        is_whole_word = false;
-                    }
-                }
-                
-                if (replace_pos + macro.first.length() < preprocessed_code.length()) {
-                    char next = preprocessed_code[replace_pos + macro.first.length()];
-                    if (isalnum(next) || next == '_') {
-                        is_whole_word = false;
-                    }
-                }
-                
-                if (is_whole_word) {
-                    preprocessed_code.replace(replace_pos, macro.first.length(), macro.second);
-                    replace_pos += macro.second.length();
-                    log_content.append("  Replaced " + macro.first + " with " + macro.second + "\n");
-                } else {
-                    replace_pos += macro.first.length();
-                }
+            short result = when_directive(text, pos, line_end, scan, branches, active);
+            if (result != 0) {
+                return result;
             }
+            copied = pos = next;
+            continue;
+        }
+        if (!active) {
+            pos++;
+            continue;
         }
-    }
 
-    // 6) Remove ALL section markers including both singular and plural versions
-    {
-        // Remove all possible section markers
-        vector<pair<string, string>> markers_to_remove = {
-            {"[preprocessor section begin]", "Preprocessor section begin"},
-            {"[preprocessor section end]", "Preprocessor section end"},
-            {"[functions section begin]", "Functions section begin (plural)"},
-            {"[functions section end]", "Functions section end (plural)"},
-            {"[function section begin]", "Function section begin (singular)"},
-            {"[function section end]", "Function section end (singular)"},
-            {"[superior function begin]", "Superior function begin"},
-            {"[superior function end]", "Superior function end"}
-        };
-        
-        for (const auto& marker : markers_to_remove) {
-            const string& marker_text = marker.first;
-            const string& marker_name = marker.second;
-            
-            size_t pos = 0;
-            while ((pos = preprocessed_code.find(marker_text, pos)) != string::npos) {
-                preprocessed_code.erase(pos, marker_text.length());
-                log_content.append("Removed: " + marker_name + "\n");
-                // Don't advance pos since we just removed the marker
+        // 3) Handle ##program "name" (только первая директива главного файла)
+        if (is_main && !scan.program_seen && text.compare(pos, 9, "##program") == 0) {
+            scan.program_seen = true;
+            out.append(text, copied, pos - copied);
+            copied = pos = next;
+            continue;
+        }
+
+        // 4) Handle ##inaddition "file" - insert functions and macros
+        if (text.compare(pos, 12, "##inaddition") == 0) {
+            string add_filename;
+            if (!extract_quoted(text, pos, add_filename)) {
+                return preprocess_error(text, pos, "malformed ##inaddition", 78, scan);
             }
+            out.append(text, copied, pos - copied);
+            copied = pos = next;
+
+            short result = include_file(add_filename, scan, depth);
+            if (result != 0) {
+                return result;
+            }
+            continue;
         }
-        
-        // Remove any remaining individual brackets just in case
-        size_t pos = 0;
-        while ((pos = preprocessed_code.find('[')) != string::npos) {
-            preprocessed_code.erase(pos, 1);
-            log_content.append("Removed stray '['\n");
+
+        // 5) Collect ##perceive macros
+        if (!scan.macros_stopped && text.compare(pos, 10, "##perceive") == 0) {
+            // function_macros может расти во вложенных ##inaddition,
+            // поэтому ссылка берется заново
+            auto& macros = is_main ? scan.macros : scan.function_macros[slot];
+            if (!parse_macro(text.substr(pos, line_end - pos), scan, macros)) {
+                // Некорректная строка и все следующие остаются в тексте
+                scan.macros_stopped = true;
+                pos++;
+                continue;
+            }
+            out.append(text, copied, pos - copied);
+            copied = pos = next;
+            continue;
         }
-        
-        pos = 0;
-        while ((pos = preprocessed_code.find(']')) != string::npos) {
-            preprocessed_code.erase(pos, 1);
-            log_content.append("Removed stray ']'\n");
+        pos++;
+    }
+
+    if (!branches.empty()) {
+        return preprocess_error(text, branches.back().pos, "##when without ##endwhen", 79,
+                                scan);
+    }
+    out.append(text, copied, string::npos);
+    return 0;
+}
+
+static const pair<const char*, const char*> markers[] = {
+    {"[preprocessor section begin]", "Preprocessor section begin"},
+    {"[preprocessor section end]", "Preprocessor section end"},
+    {"[functions section begin]", "Functions section begin (plural)"},
+    {"[functions section end]", "Functions section end (plural)"},
+    {"[function section begin]", "Function section begin (singular)"},
+    {"[function section end]", "Function section end (singular)"},
+    {"[superior function begin]", "Superior function begin"},
+    {"[superior function end]", "Superior function end"}
+};
+static const size_t marker_count = sizeof(markers) / sizeof(markers[0]);
+
+size_t SectionMarkerLength(std::string_view text, size_t pos) {
+    for (size_t m = 0; m < marker_count; m++) {
+        size_t len = strlen(markers[m].first);
+        if (text.compare(pos, len, markers[m].first) == 0) {
+            return len;
         }
     }
+    return 0;
+}
 
-    // 7) Remove @...@ comments
-    {
-        size_t at_pos = 0;
-        while ((at_pos = preprocessed_code.find('@', at_pos)) != string::npos) {
-            size_t next_at = preprocessed_code.find('@', at_pos + 1);
-            if (next_at != string::npos) {
-                // Check for tab before comment
-                size_t remove_start = at_pos;
-                if (remove_start > 0 && preprocessed_code[remove_start - 1] == '\t') {
-                    remove_start--;
+// Завершение строки выходного текста (шаг 8): обрезка пробелов по краям,
+// пустые строки отбрасываются
+static inline void finish_line(string& out, size_t line_start, int& removed_count) {
+    size_t start = line_start;
+    while (start < out.size() && (out[start] == ' ' || out[start] == '\t' || out[start] == '\r')) {
+        start++;
+    }
+    if (start == out.size()) {
+        out.resize(line_start);
+        removed_count++;
+        return;
+    }
+    size_t end = out.size();
+    while (out[end - 1] == ' ' || out[end - 1] == '\t' || out[end - 1] == '\r') {
+        end--;
+    }
+    out.resize(end);
+    if (start > line_start) {
+        out.erase(line_start, start - line_start);
+    }
+    out.push_back('\n');
+}
+
+// Шаги 6-8 одним проходом: маркеры секций и оставшиеся скобки,
+// комментарии @...@ (вместе с табуляцией перед ними), пробелы по краям
+// строк и пустые строки
+static string clean_up(const string& code, string& log_content) {
+    size_t marker_hits[marker_count] = {};
+    size_t stray_open = 0;
+    size_t stray_close = 0;
+    int removed_count = 0;
+
+    string out;
+    out.reserve(code.size());
+    size_t line_start = 0;
+    const size_t n = code.size();
+
+    for (size_t i = 0; i < n; ) {
+        char c = code[i];
+        if (c == '\n') {
+            finish_line(out, line_start, removed_count);
+            line_start = out.size();
+            i++;
+        } else if (c == '[') {
+            size_t skip = 1;
+            for (size_t m = 0; m < marker_count; m++) {
+                size_t len = strlen(markers[m].first);
+                if (code.compare(i, len, markers[m].first) == 0) {
+                    marker_hits[m]++;
+                    skip = len;
+                    break;
                 }
-                
-                preprocessed_code.erase(remove_start, next_at - remove_start + 1);
-                at_pos = remove_start;
-            } else {
-                preprocessed_code.erase(at_pos, 1);
             }
+            if (skip == 1) stray_open++;
+            i += skip;
+        } else if (c == ']') {
+            stray_close++;
+            i++;
+        } else if (c == '@') {
+            size_t next_at = code.find('@', i + 1);
+            if (next_at == string::npos) {
+                i++;
+                continue;
+            }
+            // Check for tab before comment
+            if (out.size() > line_start && out.back() == '\t') {
+                out.pop_back();
+            }
+            i = next_at + 1;
+        } else {
+            // Обычный текст копируется до следующего особого символа
+            size_t j = i + 1;
+            while (j < n && code[j] != '\n' && code[j] != '[' && code[j] != ']' && code[j] != '@') {
+                j++;
+            }
+            out.append(code, i, j - i);
+            i = j;
         }
     }
+    finish_line(out, line_start, removed_count);
 
-    // 8) Clean up empty lines and whitespace
-    {
-        istringstream iss(preprocessed_code);
-        ostringstream oss;
-        string line;
-        int removed_count = 0;
-        
-        while (getline(iss, line)) {
-            // Trim leading and trailing whitespace
-            size_t start = line.find_first_not_of(" \t\r");
-            if (start == string::npos) {
-                removed_count++;
-                continue;
+    // Remove trailing newline if present
+    if (!out.empty() && out.back() == '\n') {
+        out.pop_back();
+    }
+
+    for (size_t m = 0; m < marker_count; m++) {
+        for (size_t k = 0; k < marker_hits[m]; k++) {
+            log_content.append(string("Removed: ") + markers[m].second + "\n");
+        }
+    }
+    if (stray_open > 0) {
+        log_content.append("Removed stray '[' (" + to_string(stray_open) + ")\n");
+    }
+    if (stray_close > 0) {
+        log_content.append("Removed stray ']' (" + to_string(stray_close) + ")\n");
+    }
+    if (removed_count > 0) {
+        log_content.append("Removed " + to_string(removed_count) + " empty lines\n");
+    }
+    return out;
+}
+
+// Шаги 1-5 без подстановки: проверка заголовка, имя программы, проход по
+// директивам, вставка функций ##inaddition и свертка констант. Выход -
+// текст или отрезки исходных текстов (scan.segmented)
+static short run_directives(const string& main_file, const string& source, string& output_file,
+                            const DefineList& defines, DirectiveScan& scan, ScanOutput& code) {
+    string& log_content = scan.log_content;
+    const IncludeResolver& resolver = scan.resolver;
+    log_content.append("=====Preprocessor log=====\n");
+
+    if (source.empty()) {
+        log_content.append("Error: main file is empty or unreadable: " + main_file + "\n");
+        Error::ThrowConsole(5);
+        return -1;
+    }
+    log_content.append("Main file read: " + main_file + "\n");
+
+    // 2) Validate preprocessor section header
+    if (source.find("[preprocessor section begin]") == string::npos) {
+        size_t err_pos = 0;
+        int row, col;
+        FileWork::LineIndex(source).locate(err_pos, row, col);
+        log_content.append("Error 76 at row " + to_string(row) + ", col " + to_string(col) + "\n");
+        Error::ThrowConsole(76, row, col);
+        return -1;
+    }
+
+    // 3) Handle ##program "name" → output_file = name.txt
+    size_t program_pos = source.find("##program");
+    if (program_pos != string::npos) {
+        string out_name;
+        if (!extract_quoted(source, program_pos, out_name)) {
+            return preprocess_error(source, program_pos, "malformed ##program", 77, scan);
+        }
+        output_file = out_name + ".txt";
+        log_content.append("Output filename set to: " + output_file + "\n");
+    } else {
+        // default: derive from main_file
+        size_t dot = main_file.find_last_of('.');
+        output_file = (dot == string::npos) ? (main_file + ".txt")
+                                           : (main_file.substr(0, dot) + ".txt");
+        log_content.append("Output filename derived: " + output_file + "\n");
+    }
+
+    // 3-5) Directives: ##program, ##inaddition, ##perceive
+    if (source.find("[functions section begin]") != string::npos) {
+        scan.functions_marker = "[functions section begin]";
+    } else if (source.find("[function section begin]") != string::npos) {
+        scan.functions_marker = "[function section begin]";
+    }
+    scan.has_pp_end = source.find(PP_END_MARKER) != string::npos;
+
+    // Определения -D: раньше всех ##perceive, поэтому перекрывают их
+    // и так же подставляются в текст
+    for (const auto& define : defines) {
+        scan.macros.push_back(define);
+        log_content.append("Macro defined (command line): " + define.first + " = " +
+                           define.second + "\n");
+    }
+
+    // Файлы с диска читаются заранее и параллельно; resolver вызывается
+    // только из этого потока
+    if (!resolver) {
+        std::vector<string> names = cache::scanIncludeNames(source);
+        if (names.size() > 1) {
+            TRACE_SCOPE("prefetch includes");
+            includes::prefetch(names);
+        }
+    }
+
+    short result = scan_directives(source, scan, code, MAIN_FILE, 0);
+    if (result != 0) {
+        return result;
+    }
+
+    // Функции файлов ##inaddition - сразу после маркера секции функций,
+    // последний обработанный файл первым
+    if (!scan.included_functions.empty()) {
+        if (code.segmented) {
+            vector<Segment> inserted;
+            for (size_t i = scan.included_functions.size(); i-- > 0; ) {
+                const auto& segments = scan.included_functions[i].segments;
+                inserted.insert(inserted.end(), segments.begin(), segments.end());
             }
-            
-            size_t end = line.find_last_not_of(" \t\r");
-            string trimmed = line.substr(start, end - start + 1);
-            
-            if (!trimmed.empty()) {
-                oss << trimmed << "\n";
+            code.segments.insert(code.segments.begin() + scan.functions_at,
+                                 inserted.begin(), inserted.end());
+        } else {
+            string inserted;
+            for (size_t i = scan.included_functions.size(); i-- > 0; ) {
+                inserted += "\n" + scan.included_functions[i].text + "\n";
             }
+            code.text.insert(scan.functions_at, inserted);
         }
-        
-        preprocessed_code = oss.str();
-        
-        // Remove trailing newline if present
-        if (!preprocessed_code.empty() && preprocessed_code.back() == '\n') {
-            preprocessed_code.pop_back();
+
+        // Их макросы - в том же порядке, что и в тексте
+        vector<pair<string, string>> function_macros;
+        for (size_t i = scan.function_macros.size(); i-- > 0; ) {
+            function_macros.insert(function_macros.end(), scan.function_macros[i].begin(),
+                                   scan.function_macros[i].end());
         }
-        
-        if (removed_count > 0) {
-            log_content.append("Removed " + to_string(removed_count) + " empty lines\n");
+        scan.macros.insert(scan.macros.begin() + scan.functions_index,
+                           function_macros.begin(), function_macros.end());
+    }
+    log_content.append("Processed ##inaddition directives: " +
+                       to_string(scan.added_count) + "\n");
+
+    fold_constants(scan.macros, log_content);
+    return 0;
+}
+
+// Препроцессор работает за линейное время: проход по директивам со
+// сборкой нового текста, однопроходная подстановка макросов и проход
+// очистки. Текст нигде не изменяется на месте через erase/insert
+short PreprocessSource(const string& main_file, const string& source, string& output_file,
+                       string& preprocessed_code, string& log_content,
+                       const IncludeResolver& resolver, const DefineList& defines) {
+    stats::ScopedTimer timer(stats::STAGE_PREPROCESS);
+    DirectiveScan scan(resolver, log_content);
+    ScanOutput code(false, 0);
+    short result = run_directives(main_file, source, output_file, defines, scan, code);
+    if (result != 0) {
+        return result;
+    }
+
+    // 5) Replace all occurrences of macros
+    code.text = expand_macros(code.text, scan.macros, log_content);
+
+    // 6-8) Section markers, @...@ comments, whitespace
+    preprocessed_code = clean_up(code.text, log_content);
+
+    log_content.append("==========================\n");
+
+    return 0;
+}
+
+std::vector<string> IncludedFiles(const string& main_file, const string& source,
+                                  const DefineList& defines) {
+    // Тот же проход по директивам, что и в препроцессоре, но без текста
+    // (отрезки) и без вывода ошибок: их выдаст сама компиляция
+    std::ostringstream discard;
+    Error::OutputScope quiet(discard);
+    string log_content;
+    string output_file;
+    IncludeResolver from_disk;
+    DirectiveScan scan(from_disk, log_content);
+    scan.segmented = true;
+    ScanOutput code(true, 0);
+    run_directives(main_file, source, output_file, defines, scan, code);
+    return scan.include_names;
+}
+
+// Лексер над одним исходным текстом: строки и столбцы токенов
+// переводятся в позиции файла
+struct SourceLexer {
+    lexan::Lexer lexer;
+    int file;
+    int first_line;         // Позиция начала текста в файле
+    int first_column;
+
+    SourceLexer(const string& text, const string& name, int f, int line, int column)
+        : lexer(text, name), file(f), first_line(line), first_column(column) {
+        lexer.set_markup_skipping(true);
+    }
+
+    void place(lexan::Token& token) const {
+        if (token.line == 1) {
+            token.column += first_column - 1;
         }
+        token.line += first_line - 1;
+        token.file = file;
     }
+};
 
-    // 9) Final cleanup - remove any leftover markers that might have been missed
+// Препроцессор и лексер за один проход (-fused): директивы разбираются
+// тем же проходом, что и в PreprocessSource, но вместо нового текста
+// он отмечает отрезки исходных файлов, и лексер читает их на месте.
+// Макросы раскрываются на уровне токенов: значение каждого разбирается
+// один раз, его токены получают позицию имени макроса
+short TokenizeSource(const string& main_file, const string& source, string& output_file,
+                     std::vector<lexan::Token>& tokens, std::vector<string>& files,
+                     string& log_content, const IncludeResolver& resolver,
+                     const DefineList& defines) {
+    DirectiveScan scan(resolver, log_content);
+    scan.segmented = true;
+    ScanOutput code(true, 0);
+    short result;
     {
-        // Remove any markers that might have been left
-        vector<string> leftover_markers = {
-            "section begin]", "section end]", "function begin]", "function end]",
-            "[preprocessor", "[functions", "[function", "[superior"
-        };
-        
-        for (const auto& marker : leftover_markers) {
-            size_t pos = 0;
-            while ((pos = preprocessed_code.find(marker, pos)) != string::npos) {
-                // Remove from the previous '[' if exists, or just the marker
-                size_t start = preprocessed_code.rfind('[', pos);
-                if (start != string::npos && start < pos) {
-                    preprocessed_code.erase(start, pos + marker.length() - start);
-                    pos = start;
-                } else {
-                    preprocessed_code.erase(pos, marker.length());
+        stats::ScopedTimer timer(stats::STAGE_PREPROCESS);
+        result = run_directives(main_file, source, output_file, defines, scan, code);
+    }
+    if (result != 0) {
+        return result;
+    }
+
+    stats::ScopedTimer timer(stats::STAGE_LEXER);
+    files.assign(1, main_file);
+    files.insert(files.end(), scan.library_names.begin(), scan.library_names.end());
+
+    vector<SourceLexer> lexers;
+    lexers.reserve(scan.libraries.size() + 1);
+    lexers.emplace_back(source, main_file, 0, 1, 1);
+    for (size_t i = 0; i < scan.libraries.size(); i++) {
+        const includes::Library& library = *scan.libraries[i];
+        lexers.emplace_back(library.functions, scan.library_names[i], static_cast<int>(i + 1),
+                            library.functions_line, library.functions_column);
+    }
+
+    unordered_map<string_view, size_t> index;
+    vector<string> values;
+    vector<pair<string, string>> other;
+    resolve_macros(scan.macros, index, values, other);
+    for (const auto& macro : other) {
+        log_content.append("Warning: macro " + macro.first + " is not a word, ignored with -fused\n");
+    }
+    vector<vector<lexan::Token>> expansions(values.size());
+    vector<bool> expanded(values.size(), false);
+    vector<size_t> hits(values.size(), 0);
+
+    tokens.clear();
+    lexan::Token token;
+    bool failed = false;
+    for (const Segment& segment : code.segments) {
+        SourceLexer& source_lexer = lexers[segment.source];
+        source_lexer.lexer.set_range(segment.begin, segment.end);
+        while (!failed) {
+            token = source_lexer.lexer.get_next_token();
+            if (token.type == lexan::TK_EOF) break;
+            source_lexer.place(token);
+            if (token.type == lexan::TK_ERROR) {
+                failed = true;
+                break;
+            }
+
+            auto it = index.empty() ? index.end() : index.find(token.value);
+            if (it == index.end() || token.type == lexan::TK_STRING_LIT ||
+                token.type == lexan::TK_CHAR_LIT || token.type == lexan::TK_NUMBER) {
+                tokens.push_back(token);
+                continue;
+            }
+
+            size_t i = it->second;
+            if (!expanded[i]) {
+                // Ошибка в значении остается последним токеном раскрытия
+                expanded[i] = true;
+                lexan::Lexer value_lexer(values[i], main_file);
+                value_lexer.set_markup_skipping(true);
+                lexan::Token value_token = value_lexer.get_next_token();
+                while (value_token.type != lexan::TK_EOF) {
+                    expansions[i].push_back(value_token);
+                    if (value_token.type == lexan::TK_ERROR) break;
+                    value_token = value_lexer.get_next_token();
                 }
             }
+            hits[i]++;
+            for (lexan::Token expansion : expansions[i]) {
+                expansion.line = token.line;
+                expansion.column = token.column;
+                expansion.index = token.index;
+                expansion.file = token.file;
+                if (expansion.type == lexan::TK_ERROR) {
+                    token = expansion;
+                    failed = true;
+                    break;
+                }
+                tokens.push_back(expansion);
+            }
         }
+        if (failed) break;
     }
-
-    log_content.append("==========================\n");
-
-    // 10) Write output files
-    string base_name = output_file;
-    size_t dot_pos = base_name.find_last_of('.');
-    if (dot_pos != string::npos) {
-        base_name = base_name.substr(0, dot_pos);
+    if (!failed) {
+        // Конец главного файла
+        lexers[0].lexer.set_range(source.size(), source.size());
+        token = lexers[0].lexer.get_next_token();
     }
-    
-    string log_file = base_name + ".log";
-    string prep_file = base_name + "_prep.txt";
-    
-    // Write preprocessed code
-    if (!FileWork::WriteFile(prep_file, preprocessed_code)) {
-        log_content.append("Error: could not write preprocessed file\n");
-        FileWork::WriteFile(log_file, log_content);
+    tokens.push_back(token);
+    stats::count(stats::COUNTER_TOKENS, tokens.size());
+
+    for (size_t i = 0; i < scan.macros.size(); i++) {
+        if (hits[i] > 0) {
+            log_content.append("  Replaced " + scan.macros[i].first + " with " + scan.macros[i].second +
+                               " (" + to_string(hits[i]) + ")\n");
+        }
     }
-    
-    // Write log
-    FileWork::WriteFile(log_file, log_content);
-    
-    // Set output file for next stages
-    output_file = prep_file;
-    
-    cout << "Preprocessing completed successfully!\n";
-    cout << "  Output file: " << prep_file << "\n";
-    cout << "  Log file:    " << log_file << "\n";
-    
+    log_content.append("Tokens: " + to_string(tokens.size()) + "\n");
+    log_content.append("==========================\n");
     return 0;
-}
\ No newline at end of file
+}
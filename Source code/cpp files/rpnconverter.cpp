@@ -1,4 +1,5 @@
 #include "rpnconverter.h"
+#include "stats.h"
 #include <iostream>
 
 namespace rpn {
@@ -176,6 +177,7 @@ void RPNConverter::find_and_convert_expressions(parser::ASTNode* node,
 }
 
 std::string RPNConverter::convert_program(parser::ASTNode* program_node) {
+    stats::ScopedTimer timer(stats::STAGE_RPN);
     if (!program_node) return "";
     
     std::stringstream result;
@@ -203,7 +205,9 @@ std::string RPNConverter::convert_program(parser::ASTNode* program_node) {
         }
     }
     
-    return result.str();
+    std::string rpn_text = result.str();
+    stats::count(stats::COUNTER_BYTES_EMITTED, rpn_text.size());
+    return rpn_text;
 }
 
 } // namespace rpn
\ No newline at end of file
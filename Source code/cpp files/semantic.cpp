@@ -1,4 +1,5 @@
 #include "semantic.h"
+#include "stats.h"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -21,9 +22,9 @@ void SemanticAnalyzer::exit_scope() {
     if (scope_stack.size() > 1) {
         for (const auto& [name, symbol] : scope_stack.back()) {
             if (!symbol.is_used && !symbol.name.empty()) {
-                std::cout << "\nВ строке " << symbol.declaration_token.line 
-                          << ", столбец " << symbol.declaration_token.column
-                          << ": Неиспользуемая переменная '" << symbol.name << "'\n\n";
+                Error::out() << "\nВ строке " << symbol.declaration_token.line 
+                             << ", столбец " << symbol.declaration_token.column
+                             << ": Неиспользуемая переменная '" << symbol.name << "'\n\n";
                 has_warnings = true;
             }
         }
@@ -33,6 +34,7 @@ void SemanticAnalyzer::exit_scope() {
 }
 
 SymbolInfo* SemanticAnalyzer::lookup_symbol(const std::string& name) {
+    stats::count(stats::COUNTER_SYMBOL_LOOKUPS);
     for (int i = scope_stack.size() - 1; i >= 0; i--) {
         auto it = scope_stack[i].find(name);
         if (it != scope_stack[i].end()) {
@@ -47,6 +49,7 @@ SymbolInfo* SemanticAnalyzer::lookup_symbol(const std::string& name) {
 }
 
 FunctionInfo* SemanticAnalyzer::lookup_function(const std::string& name) {
+    stats::count(stats::COUNTER_SYMBOL_LOOKUPS);
     auto it = functions.find(name);
     if (it != functions.end()) {
         return &it->second;
@@ -59,15 +62,15 @@ bool SemanticAnalyzer::declare_symbol(const std::string& name,
                                      const lexan::Token& token,
                                      const std::string& context) {
     if (scope_stack.back().find(name) != scope_stack.back().end()) {
-        std::cout << "\nОшибка " << 302 << ": Повторное объявление переменной '" << name << "'";
-        std::cout << "\nВ строке " << token.line << ", столбец " << token.column << "\n\n";
+        Error::out() << "\nОшибка " << 302 << ": Повторное объявление переменной '" << name << "'";
+        Error::out() << "\nВ строке " << token.line << ", столбец " << token.column << "\n\n";
         has_errors = true;
         return false;
     }
     
     if (current_scope_level > 0 && global_symbols.find(name) != global_symbols.end()) {
-        std::cout << "\nВ строке " << token.line << ", столбец " << token.column
-                  << ": Переменная '" << name << "' скрывает глобальное объявление\n\n";
+        Error::out() << "\nВ строке " << token.line << ", столбец " << token.column
+                     << ": Переменная '" << name << "' скрывает глобальное объявление\n\n";
         has_warnings = true;
     }
     
@@ -87,8 +90,8 @@ bool SemanticAnalyzer::declare_function(const std::string& name,
     if (functions.find(name) != functions.end()) {
         FunctionInfo* existing = &functions[name];
         if (existing->is_defined) {
-            std::cout << "\nОшибка " << 303 << ": Повторное определение функции '" << name << "'";
-            std::cout << "\nВ строке " << token.line << ", столбец " << token.column << "\n\n";
+            Error::out() << "\nОшибка " << 303 << ": Повторное определение функции '" << name << "'";
+            Error::out() << "\nВ строке " << token.line << ", столбец " << token.column << "\n\n";
             has_errors = true;
             return false;
         } else {
@@ -158,8 +161,8 @@ TypeInfo SemanticAnalyzer::get_expression_type(parser::ASTNode* node) {
             if (func) {
                 return func->return_type;
             }
-            std::cout << "\nОшибка " << 304 << ": Необъявленный идентификатор '" << node->value << "'";
-            std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+            Error::out() << "\nОшибка " << 304 << ": Необъявленный идентификатор '" << node->value << "'";
+            Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
             has_errors = true;
             break;
         }
@@ -175,9 +178,9 @@ TypeInfo SemanticAnalyzer::get_expression_type(parser::ASTNode* node) {
             TypeInfo result = get_binary_op_result_type(left_type, right_type, node->value);
             
             if (result.name == "unknown") {
-                std::cout << "\nОшибка " << 318 << ": Некорректная операция для типов '"
-                          << left_type.name << "' и '" << right_type.name << "' с оператором '" << node->value << "'";
-                std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+                Error::out() << "\nОшибка " << 318 << ": Некорректная операция для типов '"
+                             << left_type.name << "' и '" << right_type.name << "' с оператором '" << node->value << "'";
+                Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
                 has_errors = true;
             }
             
@@ -212,8 +215,8 @@ TypeInfo SemanticAnalyzer::get_expression_type(parser::ASTNode* node) {
                 return TypeInfo("void", true, "undefined");
             }
             
-            std::cout << "\nОшибка " << 305 << ": Необъявленная функция '" << node->value << "'";
-            std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+            Error::out() << "\nОшибка " << 305 << ": Необъявленная функция '" << node->value << "'";
+            Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
             has_errors = true;
             break;
         }
@@ -385,7 +388,7 @@ void SemanticAnalyzer::analyze_program(parser::ASTNode* node) {
     
     for (const auto& [name, func] : functions) {
         if (func.is_defined && !func.is_called && name != "main") {
-            std::cout << "\nПредупреждение: Функция '" << name << "' определена, но нигде не вызывается\n\n";
+            Error::out() << "\nПредупреждение: Функция '" << name << "' определена, но нигде не вызывается\n\n";
             has_warnings = true;
         }
     }
@@ -506,10 +509,10 @@ void SemanticAnalyzer::analyze_variable_decl(parser::ASTNode* node) {
     if (node->children.size() > 1) {
         TypeInfo expr_type = get_expression_type(node->children[1]);
         if (!type_compatible(var_type, expr_type, "=")) {
-            std::cout << "\nОшибка " << 306 << ": Несоответствие типов при инициализации '" << node->value 
-                      << "'. Ожидается " << var_type.to_string()
-                      << ", получено " << expr_type.to_string();
-            std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+            Error::out() << "\nОшибка " << 306 << ": Несоответствие типов при инициализации '" << node->value 
+                         << "'. Ожидается " << var_type.to_string()
+                         << ", получено " << expr_type.to_string();
+            Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
             has_errors = true;
         }
         
@@ -525,16 +528,16 @@ void SemanticAnalyzer::analyze_assignment(parser::ASTNode* node) {
     
     auto target = node->children[0];
     if (target->type != parser::ASTNode::Type::IDENTIFIER) {
-        std::cout << "\nОшибка " << 310 << ": Цель присваивания должна быть идентификатором";
-        std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+        Error::out() << "\nОшибка " << 310 << ": Цель присваивания должна быть идентификатором";
+        Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
         has_errors = true;
         return;
     }
     
     SymbolInfo* symbol = lookup_symbol(target->value);
     if (!symbol) {
-        std::cout << "\nОшибка " << 304 << ": Необъявленная переменная '" << target->value << "' в присваивании";
-        std::cout << "\nВ строке " << target->token.line << ", столбец " << target->token.column << "\n\n";
+        Error::out() << "\nОшибка " << 304 << ": Необъявленная переменная '" << target->value << "' в присваивании";
+        Error::out() << "\nВ строке " << target->token.line << ", столбец " << target->token.column << "\n\n";
         has_errors = true;
         return;
     }
@@ -543,10 +546,10 @@ void SemanticAnalyzer::analyze_assignment(parser::ASTNode* node) {
     
     std::string op = node->value;
     if (!type_compatible(symbol->type, expr_type, op)) {
-        std::cout << "\nОшибка " << 306 << ": Несоответствие типов в присваивании '" << target->value 
-                  << "'. Ожидается " << symbol->type.to_string()
-                  << ", получено " << expr_type.to_string();
-        std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+        Error::out() << "\nОшибка " << 306 << ": Несоответствие типов в присваивании '" << target->value 
+                     << "'. Ожидается " << symbol->type.to_string()
+                     << ", получено " << expr_type.to_string();
+        Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
         has_errors = true;
         return;
     }
@@ -562,8 +565,8 @@ void SemanticAnalyzer::analyze_function_call(parser::ASTNode* node) {
     bool is_builtin = is_builtin_function(node->value);
     
     if (!func && !is_builtin) {
-        std::cout << "\nОшибка " << 305 << ": Необъявленная функция '" << node->value << "'";
-        std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+        Error::out() << "\nОшибка " << 305 << ": Необъявленная функция '" << node->value << "'";
+        Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
         has_errors = true;
         return;
     }
@@ -581,8 +584,8 @@ void SemanticAnalyzer::analyze_function_call(parser::ASTNode* node) {
                     arg_types.push_back(get_expression_type(arg));
                 }
                 if (!check_builtin_arguments(node->value, arg_types)) {
-                    std::cout << "\nОшибка " << 308 << ": Некорректные аргументы для встроенной функции '" << node->value << "'";
-                    std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+                    Error::out() << "\nОшибка " << 308 << ": Некорректные аргументы для встроенной функции '" << node->value << "'";
+                    Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
                     has_errors = true;
                 }
             }
@@ -603,9 +606,9 @@ void SemanticAnalyzer::analyze_do_while(parser::ASTNode* node) {
     
     TypeInfo cond_type = get_expression_type(node->children[1]);
     if (cond_type.name != "bool" && cond_type.name != "int") {
-        std::cout << "\nПредупреждение: Условие в do-while должно быть булевым или числовым, получено " 
-                  << cond_type.to_string();
-        std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+        Error::out() << "\nПредупреждение: Условие в do-while должно быть булевым или числовым, получено " 
+                     << cond_type.to_string();
+        Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
         has_warnings = true;
     }
     
@@ -618,26 +621,26 @@ void SemanticAnalyzer::analyze_return(parser::ASTNode* node) {
         if (func) {
             if (node->children.empty()) {
                 if (func->return_type.name != "void") {
-                    std::cout << "\nОшибка " << 307 << ": Функция '" << current_function 
-                              << "' должна возвращать значение типа " 
-                              << func->return_type.to_string();
-                    std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+                    Error::out() << "\nОшибка " << 307 << ": Функция '" << current_function 
+                                 << "' должна возвращать значение типа " 
+                                 << func->return_type.to_string();
+                    Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
                     has_errors = true;
                 }
             } else {
                 TypeInfo return_type = get_expression_type(node->children[0]);
                 if (!type_compatible(func->return_type, return_type)) {
-                    std::cout << "\nОшибка " << 306 << ": Несоответствие типа возвращаемого значения в функции '" << current_function
-                              << "'. Ожидается " << func->return_type.to_string()
-                              << ", получено " << return_type.to_string();
-                    std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+                    Error::out() << "\nОшибка " << 306 << ": Несоответствие типа возвращаемого значения в функции '" << current_function
+                                 << "'. Ожидается " << func->return_type.to_string()
+                                 << ", получено " << return_type.to_string();
+                    Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
                     has_errors = true;
                 }
             }
         }
     } else {
-        std::cout << "\nОшибка " << 319 << ": Оператор return вне функции";
-        std::cout << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
+        Error::out() << "\nОшибка " << 319 << ": Оператор return вне функции";
+        Error::out() << "\nВ строке " << node->token.line << ", столбец " << node->token.column << "\n\n";
         has_errors = true;
     }
 }
@@ -657,8 +660,9 @@ void SemanticAnalyzer::analyze_block(parser::ASTNode* node) {
 }
 
 bool SemanticAnalyzer::analyze(parser::ASTNode* ast) {
+    stats::ScopedTimer timer(stats::STAGE_SEMANTIC);
     if (!ast) {
-        std::cout << "\nОшибка " << 301 << ": AST равен null\n\n";
+        Error::out() << "\nОшибка " << 301 << ": AST равен null\n\n";
         has_errors = true;
         return false;
     }
@@ -677,7 +681,7 @@ bool SemanticAnalyzer::analyze(parser::ASTNode* ast) {
     
     for (const auto& [name, symbol] : global_symbols) {
         if (!symbol.is_initialized) {
-            std::cout << "\nПредупреждение: Глобальная переменная '" << name << "' может быть неинициализированной\n\n";
+            Error::out() << "\nПредупреждение: Глобальная переменная '" << name << "' может быть неинициализированной\n\n";
             has_warnings = true;
         }
     }
@@ -686,57 +690,57 @@ bool SemanticAnalyzer::analyze(parser::ASTNode* ast) {
 }
 
 void SemanticAnalyzer::print_symbol_table() const {
-    std::cout << "\n=== ТАБЛИЦА СИМВОЛОВ ===\n";
+    Error::out() << "\n=== ТАБЛИЦА СИМВОЛОВ ===\n";
     
     if (global_symbols.empty()) {
-        std::cout << "Нет глобальных символов\n";
+        Error::out() << "Нет глобальных символов\n";
     } else {
-        std::cout << "Глобальные символы (" << global_symbols.size() << "):\n";
-        std::cout << std::left << std::setw(20) << "Имя" 
-                  << std::setw(25) << "Тип" 
-                  << std::setw(12) << "Инициализир."
-                  << std::setw(12) << "Используется"
-                  << std::setw(15) << "Контекст\n";
-        std::cout << std::string(84, '-') << "\n";
+        Error::out() << "Глобальные символы (" << global_symbols.size() << "):\n";
+        Error::out() << std::left << std::setw(20) << "Имя" 
+                     << std::setw(25) << "Тип" 
+                     << std::setw(12) << "Инициализир."
+                     << std::setw(12) << "Используется"
+                     << std::setw(15) << "Контекст\n";
+        Error::out() << std::string(84, '-') << "\n";
         
         for (const auto& [name, symbol] : global_symbols) {
-            std::cout << std::left << std::setw(20) << name
-                      << std::setw(25) << symbol.type.to_string()
-                      << std::setw(12) << (symbol.is_initialized ? "да" : "нет")
-                      << std::setw(12) << (symbol.is_used ? "да" : "нет")
-                      << std::setw(15) << symbol.context << "\n";
+            Error::out() << std::left << std::setw(20) << name
+                         << std::setw(25) << symbol.type.to_string()
+                         << std::setw(12) << (symbol.is_initialized ? "да" : "нет")
+                         << std::setw(12) << (symbol.is_used ? "да" : "нет")
+                         << std::setw(15) << symbol.context << "\n";
         }
     }
 }
 
 void SemanticAnalyzer::print_function_table() const {
-    std::cout << "\n=== ТАБЛИЦА ФУНКЦИЙ ===\n";
+    Error::out() << "\n=== ТАБЛИЦА ФУНКЦИЙ ===\n";
     
     if (functions.empty()) {
-        std::cout << "Нет функций\n";
+        Error::out() << "Нет функций\n";
     } else {
-        std::cout << "Функции (" << functions.size() << "):\n";
-        std::cout << std::left << std::setw(20) << "Имя" 
-                  << std::setw(25) << "Тип возврата" 
-                  << std::setw(12) << "Определена"
-                  << std::setw(12) << "Вызывалась"
-                  << std::setw(12) << "Параметры"
-                  << "Строка\n";
-        std::cout << std::string(81, '-') << "\n";
+        Error::out() << "Функции (" << functions.size() << "):\n";
+        Error::out() << std::left << std::setw(20) << "Имя" 
+                     << std::setw(25) << "Тип возврата" 
+                     << std::setw(12) << "Определена"
+                     << std::setw(12) << "Вызывалась"
+                     << std::setw(12) << "Параметры"
+                     << "Строка\n";
+        Error::out() << std::string(81, '-') << "\n";
         
         for (const auto& [name, func] : functions) {
-            std::cout << std::left << std::setw(20) << name
-                      << std::setw(25) << func.return_type.to_string()
-                      << std::setw(12) << (func.is_defined ? "да" : "нет")
-                      << std::setw(12) << (func.is_called ? "да" : "нет")
-                      << std::setw(12) << func.parameters.size()
-                      << func.declaration_line << "\n";
+            Error::out() << std::left << std::setw(20) << name
+                         << std::setw(25) << func.return_type.to_string()
+                         << std::setw(12) << (func.is_defined ? "да" : "нет")
+                         << std::setw(12) << (func.is_called ? "да" : "нет")
+                         << std::setw(12) << func.parameters.size()
+                         << func.declaration_line << "\n";
         }
     }
 }
 
 void SemanticAnalyzer::print_type_summary() const {
-    std::cout << "\n=== СВОДКА ПО ТИПАМ ===\n";
+    Error::out() << "\n=== СВОДКА ПО ТИПАМ ===\n";
     
     std::unordered_map<std::string, int> type_counts;
     for (const auto& [name, symbol] : global_symbols) {
@@ -744,7 +748,7 @@ void SemanticAnalyzer::print_type_summary() const {
     }
     
     for (const auto& [type, count] : type_counts) {
-        std::cout << type << ": " << count << " переменных\n";
+        Error::out() << type << ": " << count << " переменных\n";
     }
 }
 
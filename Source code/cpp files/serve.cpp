@@ -0,0 +1,209 @@
+#include <precomph.h>
+#include "serve.h"
+#include "libngs.h"
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace serve {
+
+// Наибольший размер исходного текста в COMPILE: больший запрос отклоняется
+// до выделения памяти
+static const size_t MAX_SOURCE_SIZE = 256u << 20;
+
+// Буферизованное чтение запросов и запись ответов по файловым дескрипторам
+class Connection {
+private:
+    int in_fd;
+    int out_fd;
+    std::string buffer;
+
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = read(in_fd, chunk, sizeof(chunk));
+        if (n <= 0) return false;
+        buffer.append(chunk, n);
+        return true;
+    }
+
+public:
+    Connection(int in, int out) : in_fd(in), out_fd(out) {}
+
+    bool readLine(std::string& line) {
+        size_t end;
+        while ((end = buffer.find('\n')) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        return true;
+    }
+
+    bool readBytes(size_t count, std::string& out) {
+        while (buffer.size() < count) {
+            if (!fill()) return false;
+        }
+        out = buffer.substr(0, count);
+        buffer.erase(0, count);
+        return true;
+    }
+
+    bool writeAll(const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(out_fd, data.data() + written, data.size() - written);
+            if (n <= 0) return false;
+            written += n;
+        }
+        return true;
+    }
+};
+
+int compileSource(short call, const std::string& main_file,
+                  const std::string& source, std::string& payload) {
+    // Коды флагов -prep ... -tran (getFlagCode)
+    static const ngs::Output outputs[] = {
+        ngs::OUTPUT_PREPROCESSED, ngs::OUTPUT_TOKENS, ngs::OUTPUT_AST,
+        ngs::OUTPUT_SEMANTIC_REPORT, ngs::OUTPUT_RPN, ngs::OUTPUT_JS
+    };
+    if (call < 0 || call >= static_cast<short>(sizeof(outputs) / sizeof(outputs[0]))) {
+        Error::out() << "Mode is not supported by the compile server\n";
+        return 1;
+    }
+
+    ngs::CompileOptions options;
+    options.main_file = main_file;
+    options.output = outputs[call];
+    options.includes_from_disk = true;
+    ngs::CompileResult result = ngs::compile(source, ngs::IncludeResolver(), options);
+
+    Error::out() << result.diagnostics;
+    payload = options.output == ngs::OUTPUT_JS ? result.js : result.output;
+    if (!result.success) {
+        return 1;
+    }
+    return (options.output == ngs::OUTPUT_SEMANTIC_REPORT && !result.semantic_ok) ? 1 : 0;
+}
+
+// Обработка одного COMPILE-запроса; диагностика перехватывается через Error::OutputScope
+static bool handleCompile(Connection& connection, std::istringstream& header) {
+    std::string flag, name;
+    size_t size = 0;
+    if (!(header >> flag >> name >> size)) {
+        return connection.writeAll("ERROR malformed COMPILE request\n");
+    }
+    // Тело запроса не читается, поэтому соединение закрывается
+    if (size > MAX_SOURCE_SIZE) {
+        connection.writeAll("ERROR source too large\n");
+        return false;
+    }
+
+    std::string source;
+    if (!connection.readBytes(size, source)) {
+        return false;
+    }
+
+    std::string payload;
+    std::ostringstream diagnostics;
+    int exit_code;
+    try {
+        Error::OutputScope capture(diagnostics);
+        short call = getFlagCode(flag.c_str());
+        if (call == -1) {
+            Error::ThrowConsole(3);
+            exit_code = -1;
+        } else {
+            exit_code = compileSource(call, name, source, payload);
+        }
+    }
+    catch (...) {
+        exit_code = -1;
+    }
+
+    std::string diag = diagnostics.str();
+    return connection.writeAll("RESULT " + std::to_string(exit_code) + " " +
+                               std::to_string(payload.size()) + " " +
+                               std::to_string(diag.size()) + "\n" + payload + diag);
+}
+
+// Возвращает false, если получена команда SHUTDOWN. Ошибка записи
+// (клиент закрыл соединение) завершает только это соединение
+static bool serveConnection(Connection& connection) {
+    std::string line;
+    while (connection.readLine(line)) {
+        std::istringstream header(line);
+        std::string command;
+        header >> command;
+
+        if (command == "COMPILE") {
+            if (!handleCompile(connection, header)) break;
+        } else if (command == "PING") {
+            if (!connection.writeAll("PONG\n")) break;
+        } else if (command == "QUIT") {
+            break;
+        } else if (command == "SHUTDOWN") {
+            return false;
+        } else if (!command.empty()) {
+            if (!connection.writeAll("ERROR unknown command\n")) break;
+        }
+    }
+    return true;
+}
+
+// Построение неизменяемых таблиц до первого запроса
+static void warmUp() {
+    std::ostringstream discard;
+    Error::OutputScope quiet(discard);
+    fst::initChains();
+    Error::getErrorID(0);
+}
+
+int runServer(int argc, char* argv[]) {
+    // Запись в закрытый клиентом сокет возвращает EPIPE вместо завершения процесса
+    signal(SIGPIPE, SIG_IGN);
+    warmUp();
+
+    if (argc < 3) {
+        std::cerr << "[serve] Waiting for requests on stdin\n";
+        Connection connection(STDIN_FILENO, STDOUT_FILENO);
+        serveConnection(connection);
+        return 0;
+    }
+
+    const char* socket_path = argv[2];
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        std::cerr << "[serve] Could not create socket\n";
+        return 1;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+    unlink(socket_path);
+
+    if (bind(server_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(server_fd, 16) < 0) {
+        std::cerr << "[serve] Could not listen on " << socket_path << "\n";
+        close(server_fd);
+        return 1;
+    }
+    std::cerr << "[serve] Listening on " << socket_path << "\n";
+
+    bool running = true;
+    while (running) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) continue;
+        Connection connection(client_fd, client_fd);
+        running = serveConnection(connection);
+        close(client_fd);
+    }
+
+    close(server_fd);
+    unlink(socket_path);
+    return 0;
+}
+
+} // namespace serve
@@ -0,0 +1,94 @@
+#include <precomph.h>
+#include "stats.h"
+#include <time.h>
+
+namespace stats {
+
+thread_local Collector* active = nullptr;
+
+static const char* stage_names[STAGE_COUNT] = {
+    "preprocess", "encoding", "lexer", "parser", "fst", "semantic", "rpn", "codegen"
+};
+
+static const char* counter_names[COUNTER_COUNT] = {
+    "tokens", "ast_nodes", "fst_rule_attempts", "symbol_lookups", "bytes_emitted"
+};
+
+const char* stageName(Stage stage) {
+    return stage_names[stage];
+}
+
+const char* counterName(Counter counter) {
+    return counter_names[counter];
+}
+
+double threadCpuMs() {
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0.0;
+    }
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+Collector::Collector() : total_wall_ms(0.0) {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stages[i].wall_ms = 0.0;
+        stages[i].cpu_ms = 0.0;
+        stages[i].calls = 0;
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters[i] = 0;
+    }
+}
+
+void Collector::print(std::ostream& out) const {
+    out << "\n=== COMPILATION STATISTICS ===\n";
+    out << std::left << std::setw(14) << "Stage"
+        << std::right << std::setw(12) << "Wall (ms)"
+        << std::setw(12) << "CPU (ms)"
+        << std::setw(10) << "Calls" << "\n";
+    out << std::fixed << std::setprecision(3);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (stages[i].calls == 0) continue;
+        out << std::left << std::setw(14) << stage_names[i]
+            << std::right << std::setw(12) << stages[i].wall_ms
+            << std::setw(12) << stages[i].cpu_ms
+            << std::setw(10) << stages[i].calls << "\n";
+    }
+    out << std::left << std::setw(14) << "total"
+        << std::right << std::setw(12) << total_wall_ms << "\n";
+
+    out << "Counters:\n";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << "  " << std::left << std::setw(20) << counter_names[i]
+            << std::right << counters[i] << "\n";
+    }
+}
+
+void Collector::printJson(std::ostream& out, const std::string& program) const {
+    out << std::fixed << std::setprecision(3);
+    out << "{\"program\": \"";
+    for (char c : program) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << "\", \"total_wall_ms\": " << total_wall_ms << ", \"stages\": {";
+
+    bool first = true;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (stages[i].calls == 0) continue;
+        out << (first ? "" : ", ") << "\"" << stage_names[i] << "\": {"
+            << "\"wall_ms\": " << stages[i].wall_ms
+            << ", \"cpu_ms\": " << stages[i].cpu_ms
+            << ", \"calls\": " << stages[i].calls << "}";
+        first = false;
+    }
+
+    out << "}, \"counters\": {";
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        out << (i ? ", " : "") << "\"" << counter_names[i] << "\": " << counters[i];
+    }
+    out << "}}\n";
+}
+
+} // namespace stats
@@ -0,0 +1,116 @@
+#include <precomph.h>
+#include "tokenqueue.h"
+#include <chrono>
+
+namespace lexan {
+
+// Ожидание второй стороны: сначала уступаем процессор, затем спим,
+// чтобы простаивающий поток не занимал ядро целиком
+static void backoff(unsigned& spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+TokenQueue::TokenQueue() : head(0), tail(0), closed(false), cancelled(false) {
+    pending.reserve(BATCH_SIZE);
+}
+
+bool TokenQueue::flush() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    unsigned spins = 0;
+    while (t - head.load(std::memory_order_acquire) == CAPACITY) {
+        if (cancelled.load(std::memory_order_relaxed)) return false;
+        backoff(spins);
+    }
+
+    slots[t % CAPACITY].swap(pending);
+    tail.store(t + 1, std::memory_order_release);
+    pending.clear();
+    pending.reserve(BATCH_SIZE);
+    return true;
+}
+
+bool TokenQueue::push(Token&& token) {
+    pending.push_back(std::move(token));
+    if (pending.size() < BATCH_SIZE) {
+        return !cancelled.load(std::memory_order_relaxed);
+    }
+    return flush();
+}
+
+void TokenQueue::close() {
+    if (!pending.empty()) {
+        flush();
+    }
+    closed.store(true, std::memory_order_release);
+}
+
+bool TokenQueue::pop(std::vector<Token>& batch) {
+    size_t h = head.load(std::memory_order_relaxed);
+    unsigned spins = 0;
+    while (h == tail.load(std::memory_order_acquire)) {
+        if (closed.load(std::memory_order_acquire) &&
+            h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        backoff(spins);
+    }
+
+    batch.clear();
+    batch.swap(slots[h % CAPACITY]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+void TokenQueue::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+PipelinedLexer::PipelinedLexer(const std::string& source_code, const std::string& fname)
+    : lexer(source_code, fname), level(Log::level()), collector(stats::active),
+      finished(false) {
+    worker = std::thread(&PipelinedLexer::run, this);
+}
+
+PipelinedLexer::~PipelinedLexer() {
+    queue.cancel();
+    finish();
+}
+
+void PipelinedLexer::finish() {
+    if (finished) return;
+    finished = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+    Error::out() << messages.str();
+}
+
+void PipelinedLexer::run() {
+    Log::LevelScope level_scope(level);
+    Error::OutputScope output_scope(messages);
+    stats::active = collector;
+    produce();
+    stats::active = nullptr;
+}
+
+// Та же последовательность, что и в Lexer::tokenize():
+// поток завершается токеном EOF или первым TK_ERROR
+void PipelinedLexer::produce() {
+    TRACE_SCOPE("lex (pipelined)");
+    stats::ScopedTimer timer(stats::STAGE_LEXER);
+    Token token = lexer.get_next_token();
+    while (token.type != TK_EOF && token.type != TK_ERROR) {
+        if (!queue.push(std::move(token))) {
+            return;
+        }
+        token = lexer.get_next_token();
+    }
+    queue.push(std::move(token));
+    queue.close();
+}
+
+} // namespace lexan
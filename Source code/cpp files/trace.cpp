@@ -0,0 +1,84 @@
+#include <precomph.h>
+#include "trace.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace trace {
+
+bool enabled = false;
+
+struct Event {
+    const char* name;
+    std::string detail;
+    long long ts;
+    long long dur;
+    unsigned tid;
+};
+
+static std::mutex events_mutex;
+static std::vector<Event> events;
+static std::atomic<unsigned> next_tid(1);
+static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+long long nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+void record(const char* name, const std::string& detail, long long begin_us, long long end_us) {
+    static thread_local unsigned tid = next_tid++;
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.push_back({name, detail, begin_us, end_us - begin_us, tid});
+}
+
+void start() {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    events.clear();
+    enabled = true;
+}
+
+static void writeEscaped(std::ostream& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+}
+
+bool finish(const std::string& filename) {
+    enabled = false;
+
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cout << "Error: Could not create trace file: " << filename << "\n";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(events_mutex);
+    out << "{\"traceEvents\": [\n";
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, "
+        << "\"args\": {\"name\": \"ngs\"}}";
+    for (const auto& event : events) {
+        out << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"ngs\", \"ph\": \"X\", "
+            << "\"ts\": " << event.ts << ", \"dur\": " << event.dur
+            << ", \"pid\": 1, \"tid\": " << event.tid;
+        if (!event.detail.empty()) {
+            out << ", \"args\": {\"detail\": \"";
+            writeEscaped(out, event.detail);
+            out << "\"}";
+        }
+        out << "}";
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    events.clear();
+
+    std::cout << "Trace saved to: " << filename << "\n";
+    return true;
+}
+
+} // namespace trace
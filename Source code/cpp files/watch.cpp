@@ -0,0 +1,169 @@
+#include <precomph.h>
+#include "watch.h"
+#include "cache.h"
+#include <chrono>
+#include <set>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace watch {
+
+std::vector<std::string> collectDependencies(const std::string& main_file,
+                                             const DefineList& defines) {
+    std::string storage;
+    const std::string& source = FileWork::SourceText(main_file, storage);
+
+    std::vector<std::string> dependencies = IncludedFiles(main_file, source, defines);
+    dependencies.insert(dependencies.begin(), main_file);
+    return dependencies;
+}
+
+static std::string normalize(const std::string& path) {
+    return fs::path(path).lexically_normal().string();
+}
+
+// Наблюдение за каталогами зависимостей; wd -> каталог
+class Watcher {
+private:
+    int fd;
+    std::map<int, std::string> directories;
+
+public:
+    Watcher() : fd(inotify_init1(IN_CLOEXEC)) {}
+    ~Watcher() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool valid() const { return fd >= 0; }
+
+    // Наблюдение ровно за каталогами files: новые каталоги добавляются,
+    // каталоги файлов, выпавших из зависимостей, снимаются
+    void watch(const std::vector<std::string>& files) {
+        std::set<std::string> wanted;
+        for (const auto& file : files) {
+            std::string dir = normalize(fs::path(file).parent_path().string());
+            wanted.insert(dir.empty() ? "." : dir);
+        }
+        for (auto it = directories.begin(); it != directories.end(); ) {
+            if (wanted.count(it->second)) {
+                ++it;
+                continue;
+            }
+            inotify_rm_watch(fd, it->first);
+            it = directories.erase(it);
+        }
+        for (const auto& dir : wanted) {
+            int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (wd >= 0) {
+                directories[wd] = dir;
+            }
+        }
+    }
+
+    // Ожидание изменений; после первого события еще timeout_ms собираются
+    // последующие, чтобы одно сохранение в редакторе давало одну пересборку
+    std::set<std::string> wait(int timeout_ms, std::chrono::steady_clock::time_point& first_event) {
+        std::set<std::string> changed;
+        alignas(inotify_event) char events[4096];
+        bool first = true;
+
+        while (true) {
+            if (!first) {
+                pollfd pfd = {fd, POLLIN, 0};
+                if (poll(&pfd, 1, timeout_ms) <= 0) break;
+            }
+            ssize_t len = read(fd, events, sizeof(events));
+            if (len <= 0) break;
+            if (first) first_event = std::chrono::steady_clock::now();
+            first = false;
+
+            for (char* ptr = events; ptr < events + len; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                if (event->len > 0 && directories.count(event->wd)) {
+                    changed.insert(normalize((fs::path(directories[event->wd]) / event->name).string()));
+                }
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+};
+
+int runWatch(int argc, char* argv[]) {
+    if (argc < 3 || argv[2][0] == '-') {
+        Error::ThrowConsole(0);
+        return -1;
+    }
+
+    std::string input_files[10];
+    input_files[0] = argv[2];
+    CallOptions options;
+    for (int i = 3; i < argc; i++) {
+        if (getFlagCode(argv[i]) == 5) continue;   // -tran допускается явно
+        if (!applyOption(argv[i], options)) {
+            Error::ThrowConsole(3);
+            return -1;
+        }
+    }
+
+    Log::LevelScope level(options.log_level);
+    Watcher watcher;
+    if (!watcher.valid()) {
+        Error::out() << "[watch] inotify is not available\n";
+        Log::flush();
+        return 1;
+    }
+
+    std::vector<std::string> dependencies = collectDependencies(input_files[0], options.defines);
+    std::string last_key = cache::computeKey(input_files[0], "watch", options.defines);
+    std::string output_filename;
+    runCompilation(5, input_files, output_filename, options);
+
+    // Выходные файлы пишутся в те же каталоги, поэтому большинство
+    // событий к зависимостям не относится и молча пропускается
+    bool rebuilt = true;
+    while (true) {
+        if (rebuilt) {
+            watcher.watch(dependencies);
+            Log::info() << "\n[watch] Watching " << dependencies.size() << " file(s), Ctrl+C to stop\n";
+            rebuilt = false;
+        }
+        Log::flush();
+
+        std::chrono::steady_clock::time_point start;
+        std::set<std::string> changed = watcher.wait(20, start);
+
+        bool relevant = false;
+        for (const auto& dependency : dependencies) {
+            if (changed.count(normalize(dependency))) {
+                Log::info() << "[watch] Changed: " << dependency << "\n";
+                relevant = true;
+            }
+        }
+        if (!relevant) continue;
+
+        // Сохранение без изменения содержимого не требует пересборки
+        std::string key = cache::computeKey(input_files[0], "watch", options.defines);
+        if (!key.empty() && key == last_key) {
+            Log::info() << "[watch] Content unchanged, rebuild skipped\n";
+            continue;
+        }
+        last_key = key;
+
+        dependencies = collectDependencies(input_files[0], options.defines);
+        output_filename.clear();
+        int result = runCompilation(5, input_files, output_filename, options);
+        rebuilt = true;
+
+        // Формат числа задается отдельно, чтобы не менять его у общего потока Log
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::ostringstream ms;
+        ms << std::fixed << std::setprecision(1) << elapsed.count();
+        Log::info() << "[watch] Rebuild " << (result == 0 ? "finished" : "failed")
+                    << " " << ms.str() << " ms after the change\n";
+    }
+    return 0;
+}
+
+} // namespace watch
@@ -10,13 +10,16 @@
 #include "codegen.h"
 
 // Функции для различных этапов анализа
+// write_report - вывод таблиц символов и сохранение отчета (-emit=report)
 bool performSemanticAnalysis(parser::ASTNode* ast, 
                             const std::string& filename,
-                            semantic::SemanticAnalyzer& analyzer);
+                            semantic::SemanticAnalyzer& analyzer,
+                            bool write_report = true);
 
 bool performRPNConversion(parser::ASTNode* ast, 
                          const std::string& filename,
-                         rpn::RPNConverter& converter);
+                         rpn::RPNConverter& converter,
+                         bool write_rpn = true);
 
 bool performCodeGeneration(parser::ASTNode* ast, 
                           const std::string& filename,
@@ -0,0 +1,63 @@
+#ifndef ARTIFACTS_H
+#define ARTIFACTS_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Запись выходных файлов (журналы, _prep.txt, токены, AST, DOT, RPN, JS)
+// фоновым потоком. Этап отдает готовый буфер и продолжает работу; файл
+// пишется одним блоком во временный файл рядом и переименовывается, поэтому
+// читатель видит либо прежний файл, либо новый целиком. Файлы пишутся в
+// порядке отправки: из двух записей одного файла остается последняя.
+namespace artifacts {
+
+// Файлы одной компиляции, отданные писателю. Компиляция устанавливает
+// группу для своего потока и перед завершением ждет записи всех файлов
+class Group {
+private:
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending;
+    std::vector<std::string> failed;    // Файлы, которые не удалось записать
+
+    Group(const Group&) = delete;
+    Group& operator=(const Group&) = delete;
+
+    friend class Writer;
+    void submitted();
+    void finished(const std::string& filename, bool written);
+
+public:
+    Group() : pending(0) {}
+    // Ждет оставшиеся файлы, если wait() не вызывался (исключение этапа)
+    ~Group() { wait(); }
+
+    // Ожидание записи всех отправленных файлов; ошибки выводятся через
+    // Error::out() текущего потока. false - хотя бы один файл не записан
+    bool wait();
+
+    // Группа текущего потока: nullptr - файлы пишутся сразу
+    static Group* current();
+
+    // Установка группы текущего потока на время жизни объекта
+    class Scope {
+    private:
+        Group* saved;
+    public:
+        explicit Scope(Group* group);
+        ~Scope();
+    };
+};
+
+// Отправка data в filename писателю от имени группы текущего потока; без
+// группы - запись сразу (writeNow). false - синхронная запись не удалась
+bool write(const std::string& filename, std::string data);
+
+// Запись в вызывающем потоке (файл нужен немедленно, например для node)
+bool writeNow(const std::string& filename, const std::string& data);
+
+} // namespace artifacts
+
+#endif // ARTIFACTS_H
@@ -0,0 +1,38 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+struct CallOptions;
+
+namespace batch {
+
+// Одна программа пакета: главный файл и дополнительные файлы
+struct Job {
+    std::vector<std::string> input_files;
+};
+
+// Результат компиляции программы пакета
+struct JobResult {
+    int exit_code;
+    std::string output_filename;  // Основа имен артефактов программы
+    double seconds;
+
+    JobResult() : exit_code(-1), seconds(0.0) {}
+};
+
+// Чтение списка программ: по одной программе на строку,
+// файлы разделяются пробелами, строки с '#' - комментарии
+bool readResponseFile(const std::string& filename, std::vector<Job>& jobs);
+
+// Компиляция всех программ на пуле из workers потоков
+std::vector<JobResult> compileAll(const std::vector<Job>& jobs, short call,
+                                  const CallOptions& options, unsigned workers);
+
+// ngs -batch <file...|@list...> <flag> [-jN] [options]
+int runBatch(int argc, char* argv[]);
+
+} // namespace batch
+
+#endif // BATCH_H
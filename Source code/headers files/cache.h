@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <vector>
+#include "preprocess.h"
+
+// Кэш результатов компиляции с адресацией по содержимому.
+// Ключ - хэш сборки компилятора, главного файла и всех файлов ##inaddition,
+// включая вложенные (макросы ##perceive берутся из этих же файлов). Каталог
+// кэша задается переменной окружения NGS_CACHE_DIR (по умолчанию .ngs_cache).
+namespace cache {
+
+// Сохраненные результаты этапов
+struct Entry {
+    std::string output_filename;    // Основа имен артефактов (name_prep.txt)
+    std::string preprocessed_code;
+    std::string log_filename;       // Журнал препроцессора: восстанавливается при попадании
+    std::string log;
+    std::string token_log;          // Журнал токенов без заголовка (parser::tokenLogBody)
+    std::string js;
+    std::string diagnostics;        // Вывод семантического анализа и генерации кода
+};
+
+// mode различает записи режимов (-tran и -run генерируют код по-разному),
+// defines выбирают ветви ##when при обходе включений.
+// Пустая строка, если главный файл не удалось прочитать
+std::string computeKey(const std::string& main_file, const std::string& mode,
+                       const DefineList& defines = DefineList());
+bool load(const std::string& key, Entry& entry);
+bool store(const std::string& key, const Entry& entry);
+
+// Имена из строк ##inaddition в порядке появления: поиск по тексту, без
+// ##when и -D (для предзагрузки). Точный набор включений - IncludedFiles
+std::vector<std::string> scanIncludeNames(const std::string& source);
+
+} // namespace cache
+
+#endif // CACHE_H
@@ -1,8 +1,61 @@
+#ifndef CALL_H
+#define CALL_H
+
 #include "lexer.h"
+#include "log.h"
+
+struct PreprocessLog;
+
+// Отладочные артефакты, выбираемые -emit=
+enum EmitKind {
+	EMIT_TOKENS = 1 << 0,	// .tokens.log, .tokens.txt
+	EMIT_AST    = 1 << 1,	// .ast.txt
+	EMIT_DOT    = 1 << 2,	// .ast.dot
+	EMIT_RPN    = 1 << 3,	// .rpn.txt
+	EMIT_JS     = 1 << 4,	// .js
+	EMIT_REPORT = 1 << 5,	// таблицы и отчет семантического анализа
+	EMIT_ALL    = (1 << 6) - 1
+};
+
+// Входных файлов одной программы не больше (размер массива input_files)
+const size_t MAX_INPUT_FILES = 10;
+
+// Дополнительные параметры вызова (указываются после флага режима)
+struct CallOptions {
+	bool save_prep;		// -saveprep: сохранять <name>_prep.txt и на промежуточных этапах
+	bool use_cache;		// -nocache: не использовать кэш артефактов для -tran и -run
+	bool time_passes;	// -time-passes: таблица времени этапов и счетчиков
+	bool stats_json;	// --stats-json[=file]: та же статистика в JSON
+	std::string stats_file;	// Файл для JSON (пусто - стандартный вывод)
+	std::string trace_file;	// -trace=<file>: трассировка в формате Chrome trace-event
+	unsigned emit;		// -emit=<list>: маска EmitKind (по умолчанию все артефакты режима)
+	bool pipeline;		// -pipeline: лексер и парсер в разных потоках (tokenqueue.h)
+	bool fused;		// -fused: препроцессор и лексер одним проходом (TokenizeSource)
+	bool utf8;		// -utf8: входные файлы в UTF-8 перекодируются в Windows-1251 (decodeSource)
+	Log::Level log_level;	// -q / -v: подробность сообщений об этапах (log.h)
+	// -DNAME[=VALUE]: макросы препроцессора для ##when и подстановки (preprocess.h)
+	std::vector<std::pair<std::string, std::string>> defines;
+
+	CallOptions() : save_prep(false), use_cache(true), time_passes(false), stats_json(false),
+	                emit(EMIT_ALL), pipeline(false), fused(false), utf8(false),
+	                log_level(Log::LEVEL_INFO) {}
+
+	bool emits(EmitKind kind) const { return (emit & kind) != 0; }
+};
 
 short getFlagCode (const char* arg);
-short processCall (int argc, char* argv[], string input_files[], string& output_file);
+bool applyOption (const char* arg, CallOptions& options);
+short processCall (int argc, char* argv[], string input_files[], string& output_file,
+                   CallOptions& options);
 bool performPreprocessing(std::string input_files[], std::string& output_filename, 
-                          std::string& preprocessed_code);
+                          std::string& preprocessed_code, const CallOptions& options,
+                          PreprocessLog* log = nullptr);
 bool performLexicalAnalysis(const std::string& source_code, const std::string& filename,
-                           std::vector<lexan::Token>& tokens);
\ No newline at end of file
+                           std::vector<lexan::Token>& tokens);
+bool performFusedFrontEnd(std::string input_files[], std::string& output_filename,
+                          std::vector<lexan::Token>& tokens, const CallOptions& options,
+                          PreprocessLog* log = nullptr);
+int runCompilation(short call, std::string input_files[], std::string& output_filename,
+                   const CallOptions& options);
+
+#endif // CALL_H
@@ -1,2 +1,19 @@
 void initWindows1251Table();
+bool checkWindows1251(const string& text, string& log_content);
 bool isWindows1251(const string& text, const string& logfile_name);
+
+// Кодировка входного файла по результату decodeSource
+enum SourceEncoding {
+    SOURCE_WINDOWS1251,     // Текст взят как есть (в том числе чистый ASCII)
+    SOURCE_UTF8,            // Корректный UTF-8, перекодирован в Windows-1251
+    SOURCE_UNMAPPABLE       // Корректный UTF-8 с символом вне Windows-1251
+};
+
+// Перекодировка UTF-8 -> Windows-1251 за один проход. Текст считается
+// UTF-8, если весь состоит из корректных последовательностей UTF-8 и в нем
+// есть BOM или хотя бы один не-ASCII символ (BOM отбрасывается); иначе out
+// получает text без изменений.
+// Для SOURCE_UNMAPPABLE bad_pos - смещение первого такого символа в text,
+// bad_code - его код, содержимое out не определено
+SourceEncoding decodeSource(std::string_view text, std::string& out,
+                            size_t& bad_pos, unsigned& bad_code);
@@ -28,6 +28,23 @@ namespace Error {
     
     error_info getErrorID(unsigned short id);
     void ThrowConsole(unsigned short id, bool critical = false);
+    // С позицией в исходном файле и уточнением после сообщения
+    void ThrowConsole(unsigned short id, int line, int col, bool critical = false,
+                      const std::string& extra = "");
+
+    // Поток сообщений компилятора для текущего потока выполнения
+    // (по умолчанию буферизованная консоль, Log::console()). Все этапы
+    // пишут диагностику через out()
+    std::ostream& out();
+
+    // Перенаправление out() текущего потока на время жизни объекта
+    class OutputScope {
+    private:
+        std::ostream* saved;
+    public:
+        explicit OutputScope(std::ostream& stream);
+        ~OutputScope();
+    };
 }
 
 #endif // ERROR_H
\ No newline at end of file
@@ -1,9 +1,121 @@
+#ifndef FILEWORK_H
+#define FILEWORK_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
 namespace FileWork {
-	string ReadFile(const string& filename);
-	short WriteFile(const string output_file, string data);
-	int FindCol(string text, size_t pos);
-	int FindRow(string text, size_t pos);
+	// Содержимое файла только для чтения: обычный файл отображается в
+	// память (mmap), остальные (каналы, /dev/stdin) и файлы без места под
+	// завершающий ноль в последней странице читаются в буфер. За последним
+	// байтом view() всегда стоит '\0'. Нужно, когда текст файла не хранится
+	// как есть, а преобразуется (ReadFile с from_utf8)
+	class MappedFile {
+	private:
+		const char* data;
+		size_t length;
+		size_t mapped;              // Размер отображения, 0 - данные в buffer
+		std::string buffer;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		MappedFile() : data(""), length(0), mapped(0) {}
+		~MappedFile() { close(); }
+
+		// false - файл не открыт или не прочитан
+		bool open(const std::string& filename);
+		void close();
+		std::string_view view() const { return std::string_view(data, length); }
+	};
+
+	// Текст файла в content; если последняя строка не завершена переводом
+	// строки, он добавляется (как при построчном чтении). С from_utf8 текст
+	// в UTF-8 перекодируется в Windows-1251. 0 - файл прочитан, иначе номер
+	// выданной ошибки, content пуст: 5 - файл не открыт, 6 - символ без
+	// представления в Windows-1251 (с его строкой и столбцом)
+	short ReadFile(const std::string& filename, std::string& content, bool from_utf8 = false);
+	short WriteFile(const std::string output_file, std::string data);
+	int FindCol(const std::string& text, size_t pos);
+	int FindRow(const std::string& text, size_t pos);
 
 	std::string getCurrentDateTime();
 	bool fileExists(const std::string& filename);
+
+	// Начала строк буфера, строятся один раз: позиция -> строка и столбец
+	// (с 1) за O(log n), без копирования и повторного просмотра текста
+	class LineIndex {
+	private:
+		std::vector<size_t> starts;
+
+	public:
+		LineIndex() : starts(1, 0) {}
+		explicit LineIndex(std::string_view text) { build(text); }
+
+		void build(std::string_view text);
+		void locate(size_t pos, int& row, int& col) const;
+		// Для возрастающих позиций (лексер): поиск начинается со строки
+		// hint (с 0) и обновляет ее, поэтому стоит O(1) в среднем
+		void locate(size_t pos, int& row, int& col, size_t& hint) const;
+		int row(size_t pos) const;
+		int col(size_t pos) const;
+		size_t lineCount() const { return starts.size(); }
+	};
+
+	// Исходные файлы одной компиляции: каждый читается с диска один раз
+	// (ReadFile), проверка кодировки, препроцессор, ключ кэша и файлы
+	// ##inaddition получают общий буфер. Файл идентифицируется номером;
+	// буферы не перемещаются, пока жив объект. Потокобезопасен. Строки и
+	// столбцы диагностики считаются по тексту, который разбирает этап
+	// (после препроцессора это уже не файл), поэтому индексов строк
+	// менеджер не хранит
+	class SourceManager {
+	public:
+		typedef int FileID;
+
+		// transcode - файлы с диска читаются ReadFile с from_utf8
+		explicit SourceManager(bool transcode = false)
+			: transcode(transcode), transcode_failed(false) {}
+
+		// Номер файла, загруженного при первом обращении. Ошибка чтения
+		// выдается один раз, файл остается с пустым текстом
+		FileID load(const std::string& path);
+		// Хотя бы один файл не перекодирован (ошибка 6): компиляция
+		// прерывается, а не продолжается с пустым текстом
+		bool transcodeFailed() const;
+		bool transcoding() const { return transcode; }
+
+		const std::string& text(FileID id) const;
+
+		// Менеджер текущего потока: nullptr - файлы читаются напрямую
+		static SourceManager* current();
+
+		// Установка менеджера текущего потока на время жизни объекта
+		class Scope {
+		private:
+			SourceManager* saved;
+		public:
+			explicit Scope(SourceManager* manager);
+			~Scope();
+		};
+
+	private:
+		const bool transcode;
+		std::atomic<bool> transcode_failed;
+		mutable std::mutex mutex;
+		std::vector<std::unique_ptr<std::string>> texts;
+		std::map<std::string, FileID> ids;
+	};
+
+	// Текст файла из менеджера текущего потока или, без него, прочитанный
+	// в storage
+	const std::string& SourceText(const std::string& path, std::string& storage);
 }
+
+#endif // FILEWORK_H
@@ -0,0 +1,43 @@
+#ifndef INCLUDES_H
+#define INCLUDES_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Файлы ##inaddition, разобранные один раз на процесс (в том числе на
+// все программы -batch и все запросы -serve). Запись проверяется по
+// времени изменения и размеру файла, при их изменении - по хешу
+// содержимого: файл с прежним содержимым заново не разбирается. Файлы,
+// прочитанные с перекодировкой из UTF-8 (-utf8), кэшируются отдельно.
+namespace includes {
+
+struct Library {
+    std::string key;                        // Канонический путь (имя - для resolver)
+    bool has_functions;                     // Найдена секция функций
+    std::string functions;                  // Ее текст без маркеров и крайних пробелов
+    int functions_line;                     // Строка и столбец начала functions в файле
+    int functions_column;
+    std::vector<std::string> macro_lines;   // Строки ##perceive файла
+
+    Library() : has_functions(false), functions_line(1), functions_column(1) {}
+};
+
+// Ключ файла для поиска повторов и циклов: канонический путь
+// или имя как есть, если файлы выдает resolver
+std::string canonicalName(const std::string& name, bool from_resolver);
+
+// nullptr - файл недоступен или пуст. С resolver файл запрашивается у
+// него и кэшируется только по хешу содержимого. cached - разбор взят из кэша
+std::shared_ptr<const Library> load(const std::string& name, const IncludeResolver& resolver,
+                                    bool* cached = nullptr);
+
+// Параллельное чтение и разбор файлов с диска (и вложенных в них
+// ##inaddition) в кэш; возвращается, когда все загружены. Последующие
+// load() берут готовый разбор, и задержки чтения не складываются.
+// Отсутствующие файлы пропускаются - ошибку выдаст load()
+void prefetch(const std::vector<std::string>& names);
+
+} // namespace includes
+
+#endif // INCLUDES_H
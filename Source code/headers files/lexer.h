@@ -2,8 +2,9 @@
 #define LEXER_H
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
+#include "filework.h"
 
 namespace lexan {
     typedef enum {
@@ -81,6 +82,7 @@ namespace lexan {
         int line;
         int column;
         int index;
+        int file;       // Номер исходного файла (-fused, 0 - главный файл)
         union {
             long int_value;
             double float_value;
@@ -90,13 +92,13 @@ namespace lexan {
         bool is_float;
         bool is_signed;
         
-        Token() : type(TK_ERROR), line(0), column(0), index(0), 
+        Token() : type(TK_ERROR), line(0), column(0), index(0), file(0),
                  is_hex(false), is_octal(false), is_float(false), is_signed(false) {
             numeric_data.int_value = 0;
         }
         
-        Token(TokenType t, const std::string& v, int l, int c, int i) 
-            : type(t), value(v), line(l), column(c), index(i),
+        Token(TokenType t, std::string v, int l, int c, int i) 
+            : type(t), value(std::move(v)), line(l), column(c), index(i), file(0),
               is_hex(false), is_octal(false), is_float(false), is_signed(false) {
             numeric_data.int_value = 0;
         }
@@ -104,16 +106,26 @@ namespace lexan {
 
     class Lexer {
     private:
-        std::string source;
+        // Буфер не копируется: source_code должен жить дольше лексера
+        std::string_view source;
         std::string filename;
         size_t position;
+        // Строка и столбец начала текущего токена; вычисляются по индексу
+        // строк (update_position), а не подсчетом в advance()
+        FileWork::LineIndex lines;
+        size_t line_hint;
         int line;
         int column;
         char current_char;
-        std::map<std::string, TokenType> keywords;
-        std::map<std::string, TokenType> builtins;
+        // Конец анализируемой части source (set_range)
+        size_t limit;
+        // Разбор исходного текста без препроцессора (-fused): разметка,
+        // которую удаляет препроцессор, пропускается как пробелы
+        bool markup;
         
         void advance();
+        bool skip_markup();
+        void update_position();
         char peek(int offset = 1) const;
         void skip_whitespace();
         void skip_comment();
@@ -133,11 +145,21 @@ namespace lexan {
         Token get_next_token();
         std::vector<Token> tokenize();
         void reset();
-        std::pair<int, int> get_position() const { return {line, column}; }
+        // Анализ только части [begin, end) буфера; строки и столбцы
+        // токенов остаются позициями во всем буфере
+        void set_range(size_t begin, size_t end);
+        // Пропуск маркеров секций, одиночных [ и ] и комментариев @...@
+        void set_markup_skipping(bool enabled) { markup = enabled; }
+        std::pair<int, int> get_position() const {
+            int row, col;
+            lines.locate(position, row, col);
+            return {row, col};
+        }
         static std::string token_type_to_string(TokenType type);
         static bool is_keyword(const std::string& word);
         static bool is_builtin(const std::string& word);
-        static bool generate_token_file(const std::string& source_code, 
+        // Таблица токенов по уже готовому потоку, без повторного анализа
+        static bool generate_token_file(const std::vector<Token>& tokens,
                                        const std::string& output_filename);
     };
 }
@@ -0,0 +1,68 @@
+#ifndef LIBNGS_H
+#define LIBNGS_H
+
+#include <string>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "stats.h"
+
+// Встраиваемый интерфейс компилятора: исходный текст -> JavaScript в
+// памяти, без вывода в консоль и без обращения к файловой системе.
+// Библиотека - все исходные файлы, кроме main.cpp. compile() можно
+// вызывать одновременно из нескольких потоков.
+namespace ngs {
+
+// Текст файла ##inaddition по имени; false - файл недоступен
+typedef std::function<bool(const std::string& name, std::string& content)> IncludeResolver;
+// Получает диагностику построчно, по мере выдачи
+typedef std::function<void(const std::string& line)> DiagnosticSink;
+// Макросы препроцессора, заданные вызывающим: имя и значение
+typedef std::vector<std::pair<std::string, std::string>> DefineList;
+
+// Результат компиляции: JavaScript или, для сервера компиляции (-serve)
+// и отладки, текст промежуточного этапа, на котором компиляция
+// останавливается (CompileResult::output)
+enum Output {
+    OUTPUT_JS,                      // Только CompileResult::js
+    OUTPUT_PREPROCESSED,            // Текст после препроцессора
+    OUTPUT_TOKENS,                  // Токены: "строка:столбец ТИП "значение"" по одному в строке
+    OUTPUT_AST,                     // AST (Parser::print_ast)
+    OUTPUT_SEMANTIC_REPORT,         // Отчет семантического анализатора
+    OUTPUT_RPN                      // Польская запись программы
+};
+
+struct CompileOptions {
+    std::string main_file;          // Имя программы в диагностике
+    bool semantic_check;            // Семантический анализ перед генерацией кода
+    bool collect_stats;             // Заполнять CompileResult::stats
+    DiagnosticSink diagnostics;     // Необязательный приемник сообщений
+    DefineList defines;             // Как -DNAME=VALUE: для ##when и подстановки
+    Output output;
+    bool includes_from_disk;        // Без resolver файлы ##inaddition читаются с
+                                    // диска, как в командной строке (-serve)
+
+    CompileOptions() : main_file("input.txt"), semantic_check(true), collect_stats(false),
+                       output(OUTPUT_JS), includes_from_disk(false) {}
+};
+
+struct CompileResult {
+    bool success;                   // JavaScript (или output) получен
+    bool semantic_ok;               // Семантический анализ прошел без ошибок (как в -tran,
+                                    // ошибки семантики не останавливают генерацию)
+    std::string js;
+    std::string output;             // Текст этапа CompileOptions::output, кроме OUTPUT_JS
+    std::string diagnostics;        // Все сообщения компиляции
+    stats::Collector stats;
+
+    CompileResult() : success(false), semantic_ok(false) {}
+};
+
+// Без includes файлы ##inaddition считаются недоступными
+// (если не задан includes_from_disk)
+CompileResult compile(const std::string& source, const IncludeResolver& includes,
+                      const CompileOptions& options = CompileOptions());
+
+} // namespace ngs
+
+#endif // LIBNGS_H
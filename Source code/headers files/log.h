@@ -0,0 +1,44 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <ostream>
+
+// Сообщения о ходе компиляции с уровнями подробности (-q, -v).
+// Ошибки и предупреждения этапов выводятся через Error::out() всегда;
+// здесь - только информационный и отладочный вывод. Уровень задается
+// для текущего потока, поэтому в пакетном режиме не смешивается.
+namespace Log {
+
+enum Level {
+    LEVEL_QUIET = 0,    // -q: только ошибки и предупреждения
+    LEVEL_INFO  = 1,    // по умолчанию: сообщения об этапах
+    LEVEL_DEBUG = 2     // -v: отладочный вывод FST и генератора кода
+};
+
+Level level();
+
+// Установка уровня текущего потока на время жизни объекта
+class LevelScope {
+private:
+    Level saved;
+public:
+    explicit LevelScope(Level l);
+    ~LevelScope();
+};
+
+// Error::out() при достаточном уровне, иначе поток без вывода:
+// отброшенное сообщение не форматируется
+std::ostream& info();
+std::ostream& debug();
+
+// Консоль текущего потока с буферизацией: сообщения накапливаются и
+// попадают в stdout блоками, а не построчно. Поток вывода по умолчанию
+// для Error::out()
+std::ostream& console();
+// Сброс накопленного в stdout (перед выводом мимо console() и
+// запуском внешних процессов)
+void flush();
+
+} // namespace Log
+
+#endif // LOG_H
@@ -4,6 +4,8 @@
 #include "precomph.h"
 #include "lexer.h"
 #include "fst.h"
+#include "tokenqueue.h"
+#include <deque>
 
 namespace parser {
 
@@ -55,9 +57,21 @@ struct ASTNode {
 
 class Parser {
 private:
-    std::vector<lexan::Token> tokens;
+    // Окно токенов: tokens[0] соответствует позиции base_pos. В конвейерном
+    // режиме окно пополняется из очереди лексера по мере чтения, а токены
+    // разобранных объявлений верхнего уровня отбрасываются. deque, чтобы
+    // ссылки на токены не портились при пополнении
+    mutable std::deque<lexan::Token> tokens;
+    size_t base_pos;
     size_t current_pos;
     ASTNode* root;
+    lexan::PipelinedLexer* producer;    // nullptr - все токены уже в tokens
+    mutable bool stream_done;
+
+    const lexan::Token* token_at(size_t pos) const;
+    bool pull_batch() const;
+    void discard_consumed();
+    std::vector<lexan::Token> context_from(size_t start_pos) const;
 
     const lexan::Token& current_token() const;
     const lexan::Token& peek_token(int offset = 1) const;
@@ -94,6 +108,9 @@ private:
 
 public:
     Parser(const std::vector<lexan::Token>& token_list);
+    Parser(std::vector<lexan::Token>&& token_list);
+    // Конвейерный режим: лексер исходного текста работает в отдельном потоке
+    Parser(const std::string& source_code, const std::string& filename);
     ~Parser();
 
     bool parse();
@@ -105,10 +122,16 @@ public:
 
 bool performSyntaxAnalysis(const std::vector<lexan::Token>& tokens, 
                           const std::string& filename,
-                          parser::Parser& parser);
+                          parser::Parser& parser,
+                          bool write_ast = true, bool write_dot = true);
 void writeTokenLog(const std::vector<lexan::Token>& tokens, 
                    const std::string& filename, 
                    const std::string& log_filename);
+// Журнал токенов без заголовка (файл и дата) и его запись по готовому
+// тексту - для кэша, который хранит журнал вместо токенов
+std::string tokenLogBody(const std::vector<lexan::Token>& tokens);
+void writeTokenLog(const std::string& body, const std::string& filename,
+                   const std::string& log_filename);
 
 }
 
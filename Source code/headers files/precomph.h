@@ -13,12 +13,18 @@
 #include <algorithm>
 #include <unordered_map>
 #include <sstream>
+#include <functional>
 #include <cstdbool>
 
 using namespace std;
 namespace fs = std::filesystem;
 
+// Версия компилятора; входит в ключ кэша артефактов вместе с отпечатком
+// сборки (cache.h)
+#define NGS_VERSION "1.0"
+
 #include "error.h"
+#include "log.h"
 #include "call.h"
 #include "filework.h"
 #include "preprocess.h"
@@ -26,5 +32,7 @@ namespace fs = std::filesystem;
 #include "lexer.h"
 #include "parser.h"
 #include "fst.h"
+#include "stats.h"
+#include "trace.h"
 
 #endif // PRECOMPH_H
\ No newline at end of file
@@ -1 +1,56 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "lexer.h"
+
+// Определения командной строки (-DNAME=VALUE): имя и значение
+typedef std::vector<std::pair<string, string>> DefineList;
+
+// Журнал препроцессора: имя файла и копия содержимого (для кэша артефактов)
+struct PreprocessLog {
+    string filename;
+    string content;
+};
+
 short Preprocess (string input_files[], string& output);
+short Preprocess (string input_files[], string& output, string& preprocessed_code,
+                  bool write_prep_file, const DefineList& defines = DefineList(),
+                  PreprocessLog* log = nullptr);
+// Получение текста файла ##inaddition по имени; false - файл недоступен
+typedef std::function<bool(const string& name, string& content)> IncludeResolver;
+
+// Препроцессирование исходного текста в памяти, без записи файлов.
+// output получает имя программы (##program или имя главного файла).
+// Файлы ##inaddition запрашиваются у resolver, без него читаются с диска.
+// Блоки ##when NAME / ##otherwise / ##endwhen вычисляются по ##perceive
+// и defines; текст невыполненных ветвей удаляется до лексера
+short PreprocessSource (const string& main_file, const string& source, string& output,
+                        string& preprocessed_code, string& log_content,
+                        const IncludeResolver& resolver = IncludeResolver(),
+                        const DefineList& defines = DefineList());
+
+// Препроцессор и лексер одним проходом (-fused): исходные файлы читаются
+// один раз, токены получают строку и столбец в своем файле, file - номер
+// в files (0 - главный файл, далее файлы ##inaddition). Макросы
+// раскрываются по токенам: внутри строковых констант не подставляются
+short TokenizeSource (const string& main_file, const string& source, string& output,
+                      std::vector<lexan::Token>& tokens, std::vector<string>& files,
+                      string& log_content, const IncludeResolver& resolver = IncludeResolver(),
+                      const DefineList& defines = DefineList());
+// То же для файла с записью журнала; _prep.txt не создается
+short PreprocessTokens (string input_files[], string& output, std::vector<lexan::Token>& tokens,
+                        std::vector<string>& files, const DefineList& defines = DefineList(),
+                        PreprocessLog* log = nullptr);
+
+// Файлы ##inaddition программы с вложенными, под именами из директив, в
+// порядке включения: те же, что включит препроцессор с этими defines
+// (ветви ##when учитываются, повторы и циклы пропускаются). Отсутствующие
+// файлы тоже входят. Ключ кэша и -watch следят за этим набором
+std::vector<string> IncludedFiles (const string& main_file, const string& source,
+                                   const DefineList& defines = DefineList());
+
+// Длина маркера секции ([preprocessor section begin] и т.п.) в позиции
+// pos, 0 - маркера нет
+size_t SectionMarkerLength (std::string_view text, size_t pos);
+
+#endif // PREPROCESS_H
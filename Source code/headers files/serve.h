@@ -0,0 +1,31 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <string>
+
+// Постоянный процесс компиляции (ngs -serve [socket]).
+//
+// Протокол (stdin/stdout или Unix-сокет), запросы обрабатываются по очереди:
+//   COMPILE <flag> <name> <bytes>\n<bytes байт исходного текста>
+//     -> RESULT <exit_code> <payload_bytes> <diagnostics_bytes>\n<payload><diagnostics>
+//   PING\n     -> PONG\n
+//   QUIT\n     -> завершение соединения
+//   SHUTDOWN\n -> остановка сервера
+//
+// payload зависит от флага: -prep - текст после препроцессора, -lex - токены,
+// -syn - AST, -sem - отчет анализатора, -pol - ПОЛИЗ, -tran - JavaScript.
+// <name> - имя главного файла (для ##inaddition и имен в диагностике).
+// При <bytes> больше 256 МБ ответ ERROR source too large, соединение
+// закрывается.
+namespace serve {
+
+// Компиляция исходного текста в памяти (ngs::compile); диагностика идет
+// в Error::out()
+int compileSource(short call, const std::string& main_file,
+                  const std::string& source, std::string& payload);
+
+int runServer(int argc, char* argv[]);
+
+} // namespace serve
+
+#endif // SERVE_H
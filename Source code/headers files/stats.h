@@ -0,0 +1,91 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <string>
+#include <ostream>
+#include <chrono>
+
+// Время этапов компиляции и счетчики (-time-passes, --stats-json).
+// Сборщик привязан к потоку: в пакетном режиме каждая программа
+// считается отдельно. Пока сборщик не установлен, замеры не выполняются.
+namespace stats {
+
+enum Stage {
+    STAGE_PREPROCESS,
+    STAGE_ENCODING,
+    STAGE_LEXER,
+    STAGE_PARSER,
+    STAGE_FST,
+    STAGE_SEMANTIC,
+    STAGE_RPN,
+    STAGE_CODEGEN,
+    STAGE_COUNT
+};
+
+enum Counter {
+    COUNTER_TOKENS,
+    COUNTER_AST_NODES,
+    COUNTER_FST_ATTEMPTS,
+    COUNTER_SYMBOL_LOOKUPS,
+    COUNTER_BYTES_EMITTED,
+    COUNTER_COUNT
+};
+
+struct StageTime {
+    double wall_ms;
+    double cpu_ms;
+    unsigned long calls;
+};
+
+struct Collector {
+    StageTime stages[STAGE_COUNT];
+    unsigned long long counters[COUNTER_COUNT];
+    double total_wall_ms;
+
+    Collector();
+    void print(std::ostream& out) const;
+    void printJson(std::ostream& out, const std::string& program) const;
+};
+
+// Сборщик текущего потока (nullptr - статистика выключена)
+extern thread_local Collector* active;
+
+inline void count(Counter counter, unsigned long long n = 1) {
+    if (active) active->counters[counter] += n;
+}
+
+double threadCpuMs();
+
+// Замер времени этапа на время жизни объекта. Вложенные этапы
+// (FST внутри синтаксического анализа) учитываются в обоих
+class ScopedTimer {
+private:
+    Stage stage;
+    bool enabled;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start;
+
+public:
+    explicit ScopedTimer(Stage s) : stage(s), enabled(active != nullptr), cpu_start(0.0) {
+        if (enabled) {
+            wall_start = std::chrono::steady_clock::now();
+            cpu_start = threadCpuMs();
+        }
+    }
+
+    ~ScopedTimer() {
+        if (!enabled || !active) return;
+        std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - wall_start;
+        StageTime& time = active->stages[stage];
+        time.wall_ms += wall.count();
+        time.cpu_ms += threadCpuMs() - cpu_start;
+        time.calls++;
+    }
+};
+
+const char* stageName(Stage stage);
+const char* counterName(Counter counter);
+
+} // namespace stats
+
+#endif // STATS_H
@@ -0,0 +1,74 @@
+#ifndef TOKENQUEUE_H
+#define TOKENQUEUE_H
+
+#include "lexer.h"
+#include "log.h"
+#include "stats.h"
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace lexan {
+
+// Ограниченный кольцевой буфер пачек токенов между одним производителем
+// (поток лексера) и одним потребителем (парсер). Пиковая память на токены
+// ограничена CAPACITY * BATCH_SIZE, а не размером всей программы.
+class TokenQueue {
+public:
+    static const size_t BATCH_SIZE = 256;
+    static const size_t CAPACITY = 64;
+
+    TokenQueue();
+
+    // Производитель. false - потребитель отказался от токенов (cancel)
+    bool push(Token&& token);
+    void close();
+
+    // Потребитель. false - токенов больше не будет
+    bool pop(std::vector<Token>& batch);
+    void cancel();
+
+private:
+    std::vector<Token> slots[CAPACITY];
+    std::atomic<size_t> head;       // Следующая пачка для чтения
+    std::atomic<size_t> tail;       // Следующая пачка для записи
+    std::atomic<bool> closed;
+    std::atomic<bool> cancelled;
+    std::vector<Token> pending;     // Заполняемая пачка производителя
+
+    bool flush();
+};
+
+// Лексер в отдельном потоке, выдающий токены через TokenQueue.
+// Поток работает с уровнем Log и сборщиком статистики создавшего его
+// потока; его сообщения копятся отдельно и выводятся в Error::out()
+// создавшего потока в finish(). Деструктор останавливает поток, даже
+// если парсер не дочитал токены.
+class PipelinedLexer {
+private:
+    Lexer lexer;
+    TokenQueue queue;
+    Log::Level level;
+    stats::Collector* collector;
+    std::ostringstream messages;
+    bool finished;
+    std::thread worker;
+
+    void run();
+    void produce();
+
+public:
+    PipelinedLexer(const std::string& source_code, const std::string& fname = "");
+    ~PipelinedLexer();
+
+    TokenQueue& tokens() { return queue; }
+
+    // Ожидание конца потока и вывод его сообщений; вызывается из
+    // создавшего потока, когда получен последний токен (EOF или TK_ERROR)
+    void finish();
+};
+
+} // namespace lexan
+
+#endif // TOKENQUEUE_H
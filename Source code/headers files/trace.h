@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+// Трассировка компиляции в формате Chrome trace-event (-trace=<file>).
+// Файл открывается в about://tracing или ui.perfetto.dev.
+// Пока трассировка не включена, TRACE_SCOPE сводится к проверке флага.
+namespace trace {
+
+// Устанавливается start() до запуска рабочих потоков
+extern bool enabled;
+
+long long nowUs();
+void record(const char* name, const std::string& detail, long long begin_us, long long end_us);
+
+void start();
+// Запись накопленных событий в файл и выключение трассировки
+bool finish(const std::string& filename);
+
+class Span {
+private:
+    const char* name;
+    std::string detail;
+    long long begin_us;
+    bool active;
+
+public:
+    explicit Span(const char* n) : name(n), begin_us(0), active(enabled) {
+        if (active) begin_us = nowUs();
+    }
+
+    // Уточнение события (имя файла, функции); отображается в args
+    void setDetail(const std::string& d) {
+        if (active) detail = d;
+    }
+
+    ~Span() {
+        if (active) record(name, detail, begin_us, nowUs());
+    }
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace::Span TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+#endif // TRACE_H
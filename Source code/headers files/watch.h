@@ -0,0 +1,26 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <string>
+#include <vector>
+#include "preprocess.h"
+
+// Режим наблюдения (ngs -watch <file> [options]).
+//
+// Главный файл и все файлы ##inaddition отслеживаются через inotify
+// (наблюдаются их каталоги, чтобы сохранение через переименование тоже
+// замечалось). После изменения программа пересобирается как -tran в том же
+// процессе; если содержимое зависимостей не изменилось, сборка пропускается,
+// а повторяющиеся состояния берутся из кэша артефактов (cache.h).
+namespace watch {
+
+// Главный файл и файлы ##inaddition, включая вложенные, в порядке
+// включения (IncludedFiles с теми же defines, что и у сборки)
+std::vector<std::string> collectDependencies(const std::string& main_file,
+                                             const DefineList& defines = DefineList());
+
+int runWatch(int argc, char* argv[]);
+
+} // namespace watch
+
+#endif // WATCH_H
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Вывод -tran при попадании в кэш совпадает с выводом полного прохода:
+# ошибки и предупреждения семантического анализа не теряются.
+# Запуск: sh cache_replay.sh путь/к/ngs
+NGS=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+
+cat > semantic_error.txt <<'PROGRAM'
+[preprocessor section begin]
+##program "semantic_error"
+[preprocessor section end]
+
+[superior function begin]
+ces
+{
+    est int x;
+    x = "text";
+    proclaim(y);
+}
+[superior function end]
+PROGRAM
+
+export NGS_CACHE_DIR="$WORK/cache"
+"$NGS" semantic_error.txt -tran -q > cold.txt 2>&1
+"$NGS" semantic_error.txt -tran -q > warm.txt 2>&1
+
+if ! grep -q "Ошибка 306" cold.txt; then
+    echo "FAIL: semantic error not reported on a cold build"
+    exit 1
+fi
+if [ -z "$(ls cache)" ]; then
+    echo "FAIL: nothing stored in the cache"
+    exit 1
+fi
+if ! diff cold.txt warm.txt; then
+    echo "FAIL: cached output differs from a cold build"
+    exit 1
+fi
+echo "ok"